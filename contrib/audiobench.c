@@ -0,0 +1,179 @@
+/* A microbenchmark for update_audio(). It links the Paula emulation of
+   uadecore (audio.o, sd-sound.o and the BLEP tables) without the CPU and
+   the rest of the chipset, and stubs out what they need from them.
+
+   Four channels play 64-word loops from chip memory at fixed periods and
+   volumes. update_audio() is called every 12-27 bus cycles from a fixed
+   pseudo-random sequence, which is about how often the CPU emulation
+   calls it when a replayer writes Paula registers. Output blocks are
+   thrown away. The channel state and the call sequence are the same on
+   every run, so numbers from different builds can be compared.
+
+   USAGE: make audiobench && src/audiobench [resampler] [calls] [runs]
+
+   resampler is default, sinc or none. The best and the median time per
+   call over the runs are printed.
+*/
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include <time.h>
+
+#include "options.h"
+#include "memory.h"
+#include "custom.h"
+#include "gensound.h"
+#include "sd-sound.h"
+#include "events.h"
+#include "cia.h"
+#include "audio.h"
+#include "uadectl.h"
+#include <uade/amigafilter.h>
+#include <uade/uadeconstants.h>
+
+#define BENCH_CHIPMEM_WORDS 256
+
+/* Stubs for the parts of uadecore that are not linked in */
+struct uae_prefs currprefs;
+unsigned long int cycles;
+struct ev eventtab[ev_max];
+uae_u16 adkcon;
+int maxhpos = 227;
+unsigned int ciaapra;
+unsigned int gui_ledstate;
+int gui_ledstate_forced;
+int uadecore_audio_output = 1;
+int uadecore_audio_skip;
+int uadecore_block_size = 4096;
+int uadecore_read_size = 4096;
+int uadecore_reboot;
+
+static unsigned long output_blocks;
+static uae_u16 chipmem_words[BENCH_CHIPMEM_WORDS];
+
+static uae_u32 REGPARAM2 bench_wget (uaecptr addr)
+{
+    return chipmem_words[(addr >> 1) % BENCH_CHIPMEM_WORDS];
+}
+
+addrbank chipmem_bank = { .wget = bench_wget };
+
+void event_reschedule (int ev)
+{
+}
+
+void INTREQ (uae_u16 v)
+{
+}
+
+uae_u16 INTREQR (void)
+{
+    return 0;
+}
+
+void uadecore_check_sound_buffers(int bytes)
+{
+    output_blocks++;
+}
+
+void uadecore_send_debug(const char *fmt, ...)
+{
+}
+
+
+/* Starts the channels the way a DMACON write does in custom.c */
+static void start_channels (void)
+{
+    static const int periods[4] = {124, 214, 339, 428};
+    static const int volumes[4] = {64, 48, 40, 56};
+    int i;
+
+    for (i = 0; i < BENCH_CHIPMEM_WORDS; i++)
+	chipmem_words[i] = ((i * 37) & 0xff) << 8 | ((i * 91 + 17) & 0xff);
+
+    eventtab[ev_hsync].evtime = cycles + maxhpos;
+
+    for (i = 0; i < 4; i++) {
+	struct audio_channel_data *cdp = audio_channel + i;
+
+	AUDxLCH (i, 0);
+	AUDxLCL (i, i * 128);
+	AUDxLEN (i, 64);
+	AUDxPER (i, periods[i]);
+	AUDxVOL (i, volumes[i]);
+
+	cdp->dmaen = 1;
+	cdp->state = 1;
+	cdp->pt = cdp->lc;
+	cdp->wper = cdp->per;
+	cdp->wlen = cdp->len;
+	cdp->data_written = 2;
+	cdp->evtime = eventtab[ev_hsync].evtime - cycles;
+    }
+    audio_schedule ();
+}
+
+static double run (const char *resampler, unsigned long calls)
+{
+    struct timespec t0, t1;
+    uae_u32 seed = 1;
+    unsigned long i;
+
+    cycles = 0;
+    output_blocks = 0;
+    audio_reset ();
+    audio_set_resampler ((char *) resampler);
+    audio_set_filter (FILTER_MODEL_A500, 0);
+    flush_sound ();
+    start_channels ();
+
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    for (i = 0; i < calls; i++) {
+	seed = seed * 1103515245 + 12345;
+	cycles += 12 + ((seed >> 16) & 15);
+	update_audio ();
+    }
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+
+    return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / calls;
+}
+
+static int compare_doubles (const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return x < y ? -1 : x > y;
+}
+
+int main (int argc, char **argv)
+{
+    const char *resampler = argc > 1 ? argv[1] : "default";
+    unsigned long calls = argc > 2 ? strtoul (argv[2], NULL, 10) : 10000000;
+    int runs = argc > 3 ? atoi (argv[3]) : 5;
+    double *ns;
+    int i;
+
+    if (calls == 0 || runs <= 0) {
+	fprintf (stderr, "usage: %s [resampler] [calls] [runs]\n", argv[0]);
+	return 1;
+    }
+    ns = malloc (runs * sizeof ns[0]);
+    if (ns == NULL)
+	return 1;
+
+    currprefs.sound_freq = UADE_DEFAULT_FREQUENCY;
+    currprefs.sound_bits = 16;
+    currprefs.stereo = 1;
+    currprefs.sound_maxbsiz = 8192;
+    init_sound ();
+
+    for (i = 0; i < runs; i++)
+	ns[i] = run (resampler, calls);
+    qsort (ns, runs, sizeof ns[0], compare_doubles);
+
+    printf ("%s: %lu calls, %lu output blocks per run, "
+	    "best %.1f ns, median %.1f ns per call\n",
+	    resampler, calls, output_blocks, ns[0], ns[runs / 2]);
+    free (ns);
+    return 0;
+}
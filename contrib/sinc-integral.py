@@ -1,8 +1,8 @@
-#!/usr/bin/python
+#!/usr/bin/python3
 
 import math
 import sys
-from scipy import array, exp
+from numpy import exp
 from scipy.signal import firwin
 from scipy.fftpack import fft, ifft
 
@@ -14,18 +14,22 @@ def fir_minphase(table, pad_size=8):
 
     # compute the real cepstrum
     # fft -> abs + ln -> ifft -> real
-    cepstrum = ifft(map(lambda x: math.log(x), abs(fft(table))))
+    # an even length table can have an exact zero at nyquist. The log is
+    # not defined there, so use the smallest nonzero magnitude instead.
+    magnitudes = abs(fft(table))
+    smallest = min(x for x in magnitudes if x > 0)
+    cepstrum = ifft([math.log(x if x > 0 else smallest) for x in magnitudes])
     # because the positive and negative freqs were equal, imaginary content is neglible
     # cepstrum = map(lambda x: x.real, cepstrum)
 
     # window the cepstrum in such a way that anticausal components become rejected
-    cepstrum[1                :len(cepstrum)/2] *= 2;
-    cepstrum[len(cepstrum)/2+1:len(cepstrum)  ] *= 0;
+    cepstrum[1                 :len(cepstrum)//2] *= 2;
+    cepstrum[len(cepstrum)//2+1:len(cepstrum)   ] *= 0;
 
     # now cancel the previous steps:
     # fft -> exp -> ifft -> real
-    cepstrum = ifft(map(exp, fft(cepstrum)))
-    return map(lambda x: x.real, cepstrum[0:convolution_size])
+    cepstrum = ifft(exp(fft(cepstrum)))
+    return [x.real for x in cepstrum[0:convolution_size]]
 
 class BiquadFilter(object):
     __slots__ = ['b0', 'b1', 'b2', 'a1', 'a2', 'x1', 'x2', 'y1', 'y2']
@@ -119,27 +123,27 @@ def lin2db(lin):
     return 20 * (math.log(lin) / math.log(10))
 
 def print_spectrum(table, sample_rate):
-    for _ in range(len(table) / 2):
+    for _ in range(len(table) // 2):
         mag = lin2db(abs(table[_]))
         pha = math.atan2(table[_].real, table[_].imag)
-        print "%s %s %s" % (float(_) / len(table) * sample_rate, mag, pha)
+        print("%s %s %s" % (float(_) / len(table) * sample_rate, mag, pha))
 
 def print_fir(table, format='gnuplot'):
     if format == 'gnuplot':
         for _ in range(len(table)):
-            print "%s %s" % (_, table[_])
+            print("%s %s" % (_, table[_]))
     elif format == 'c':
         col = 0
-        print "    {"
+        print("    {")
         for _ in range(len(table)):
             col += len(str(table[_])) + 1
             if col >= 80:
-                print
+                print()
                 col = 0
             sys.stdout.write("%s," % table[_])
         if col != 0:
-            print
-        print "    },"
+            print()
+        print("    },")
 
 def integrate(table):
     total = 0
@@ -203,7 +207,7 @@ def main():
     amiga1200_on, error1200_on = run_filter(filter_led, amiga1200_off)
 
     # these values tell the error from truncating the run_filter() result at end.
-    # print "error term magnitudes: %s" % map(lin2db, (error500_off, error500_on, error1200_off, error1200_on))
+    # print("error term magnitudes: %s" % map(lin2db, (error500_off, error500_on, error1200_off, error1200_on)))
 
     if not spectrum:
         # integrate to produce blep
@@ -237,20 +241,20 @@ def main():
         table += [0] * (16384 - len(table))
         print_spectrum(fft(table), sample_rate=AMIGA_PAL_CLOCK)
     else:
-        print " /*"
-        print "  * Table generated by contrib/sinc-integral.py."
-        print "  */"
-        print
-        print '#include "sinctable.h"'
-        print
-        print "/* tables are: a500 off, a500 on, a1200 off, a1200 on, vanilla. */"
-        print "const int winsinc_integral[5][%d] = {" % len(unfiltered_a1200)
+        print(" /*")
+        print("  * Table generated by contrib/sinc-integral.py.")
+        print("  */")
+        print()
+        print('#include "sinctable.h"')
+        print()
+        print("/* tables are: a500 off, a500 on, a1200 off, a1200 on, vanilla. */")
+        print("const int winsinc_integral[5][%d] = {" % len(unfiltered_a1200))
         print_fir(amiga500_off, format='c')
         print_fir(amiga500_on, format='c')
         print_fir(amiga1200_off, format='c')
         print_fir(amiga1200_on, format='c')
         print_fir(unfiltered_a1200, format='c')
-        print "};"
+        print("};")
 
 if __name__ == '__main__':
     main()
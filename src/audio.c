@@ -22,21 +22,30 @@
 #include "cia.h"
 #include "audio.h"
 #include <uade/amigafilter.h>
+#include <uade/uadeconstants.h>
 #include "uadectl.h"
 #include <uade/compilersupport.h>
 
 #include "sinctable.h"
+#include "blep.h"
 
 #include "text_scope.h"
 
 
 struct audio_channel_data audio_channel[4];
+struct audio_channel_sinc audio_channel_sinc[4];
+struct audio_channel_debug audio_channel_debug[4];
 static void (*sample_handler) (void);
 static void (*sample_prehandler) (unsigned long best_evtime);
 
-/* Average time in bus cycles to output a new sample */
-static float sample_evtime_interval;
-static float next_sample_evtime;
+/* The time to the next output sample is next_sample_cycles bus cycles plus
+   next_sample_frac / sample_rate. The interval between samples,
+   SOUNDTICKS / sample_rate, is kept the same way. Being exact, the sample
+   clock does not drift however long a song plays. */
+static unsigned long sample_rate;
+static unsigned long sample_interval_cycles, sample_interval_frac;
+static long next_sample_cycles;
+static unsigned long next_sample_frac;
 
 int sound_available;
 
@@ -51,17 +60,47 @@ static int sound_use_filter = FILTER_MODEL_A500;
 
 static unsigned long last_audio_cycles;
 
+/* Set when channel state that audio_schedule() depends on was changed
+   without rescheduling. Until then update_audio() at the same cycle as the
+   previous call has nothing to do. */
+int audio_schedule_dirty;
+
+/* Periods below 16 are raised to 16 if set. This is a fallback for slow
+   machines, see AUDxPER(). */
+static int period_clamp;
 static int audperhack;
 
+typedef float v4sf __attribute__ ((vector_size (16)));
+typedef double v2df __attribute__ ((vector_size (16)));
+
+/* Each lane is one output channel: left and right, or the four voices when
+   they are output separately */
 static struct filter_state {
-    float rc1, rc2, rc3, rc4, rc5;
-} sound_filter_state[2];
+    v4sf rc1, rc2, rc3, rc4, rc5;
+} sound_filter_state;
+
+/* Unfiltered frames at the end of the sound buffer, see audio_flush_filter() */
+static v4sf filter_block[MAX_SOUND_BUF_SIZE / 4];
+static int filter_block_frames;
+static int filter_block_led;
 
 static float a500e_filter1_a0;
 static float a500e_filter2_a0;
 static float filter_a0; /* a500 and a1200 use the same */
 
 
+/* x + DENORMAL_OFFSET for each lane. The sum is computed in double like
+   it is in scalar code. */
+static inline v4sf add_denormal_offset(v4sf x)
+{
+    v2df lo = {x[0], x[1]};
+    v2df hi = {x[2], x[3]};
+    lo += DENORMAL_OFFSET;
+    hi += DENORMAL_OFFSET;
+    return (v4sf) {lo[0], lo[1], hi[0], hi[1]};
+}
+
+
 static inline int clamp_sample(int o)
 {
     if (unlikely(o > 32767 || o < -32768)) {
@@ -75,6 +114,52 @@ static inline int clamp_sample(int o)
 }
 
 
+/* Output samples are computed on the int16 scale, but they may exceed it.
+   The int16 and int32 formats clip, float is passed on as it is. */
+static inline void put_sample(int x)
+{
+    if (likely(sound_sample_format == UADE_SAMPLE_S16)) {
+	uae_s16 v = clamp_sample(x);
+	memcpy(sndbufpt, &v, sizeof v);
+	sndbufpt += sizeof v;
+    } else if (sound_sample_format == UADE_SAMPLE_S32) {
+	uae_s32 v = clamp_sample(x) * 65536;
+	memcpy(sndbufpt, &v, sizeof v);
+	sndbufpt += sizeof v;
+    } else {
+	float v = x * (1.0f / 32768);
+	memcpy(sndbufpt, &v, sizeof v);
+	sndbufpt += sizeof v;
+    }
+}
+
+
+/* Stores a filter output sample at p in the negotiated format. Float and
+   int32 keep the fraction that int16 truncates away. */
+static inline uae_u8 *store_sample_float(uae_u8 *p, float x)
+{
+    if (likely(sound_sample_format == UADE_SAMPLE_S16)) {
+	uae_s16 v = clamp_sample(x);
+	memcpy(p, &v, sizeof v);
+	return p + sizeof v;
+    } else if (sound_sample_format == UADE_SAMPLE_S32) {
+	uae_s32 v;
+	if (unlikely(x >= 32768.0f))
+	    v = 0x7fffffff;
+	else if (unlikely(x <= -32768.0f))
+	    v = -0x7fffffff - 1;
+	else
+	    v = x * 65536;
+	memcpy(p, &v, sizeof v);
+	return p + sizeof v;
+    } else {
+	float v = x * (1.0f / 32768);
+	memcpy(p, &v, sizeof v);
+	return p + sizeof v;
+    }
+}
+
+
 /* Amiga has two separate filtering circuits per channel, a static RC filter
  * on A500 and the LED filter. This code emulates both.
  * 
@@ -89,41 +174,76 @@ static inline int clamp_sample(int o)
  *
  * The current filtering should be accurate to 2 dB with the filter on,
  * and to 1 dB with the filter off.
+ *
+ * The filter is run on blocks of output frames. sample_backend() queues
+ * unfiltered frames to filter_block, and audio_flush_filter() filters them
+ * before the sound buffer is sent or emptied, and before any setting that
+ * the filter or the buffer layout depends on is changed. The lanes of a frame are
+ * left and right, or the four voices, so all channels are filtered with
+ * the same vector operations. The LED state is constant within a block:
+ * sample_backend() flushes the block when the LED changes.
 */
 
-static int filter(int input, struct filter_state *fs)
+void audio_flush_filter (void)
 {
-    float tmp, normal_output, led_output;
+    int nframes = filter_block_frames;
+    int channels = sound_separate_voices ? 4 : 2;
+    uae_u8 *p;
+    v4sf rc1 = sound_filter_state.rc1, rc2 = sound_filter_state.rc2;
+    v4sf rc3 = sound_filter_state.rc3, rc4 = sound_filter_state.rc4;
+    v4sf rc5 = sound_filter_state.rc5;
+    v4sf a0 = {filter_a0, filter_a0, filter_a0, filter_a0};
+    v4sf b0 = 1 - a0;
+    int i, nr;
+
+    if (nframes == 0)
+	return;
+    filter_block_frames = 0;
+    p = sndbufpt - nframes * sound_bytes_per_frame;
 
     switch (sound_use_filter) {
-    case FILTER_MODEL_A500: 
-	fs->rc1 = a500e_filter1_a0 * input + (1 - a500e_filter1_a0) * fs->rc1 + DENORMAL_OFFSET;
-	fs->rc2 = a500e_filter2_a0 * fs->rc1 + (1-a500e_filter2_a0) * fs->rc2;
-	normal_output = fs->rc2;
-
-	fs->rc3 = filter_a0 * normal_output + (1 - filter_a0) * fs->rc3;
-	fs->rc4 = filter_a0 * fs->rc3       + (1 - filter_a0) * fs->rc4;
-	fs->rc5 = filter_a0 * fs->rc4       + (1 - filter_a0) * fs->rc5;
-
-	led_output = fs->rc5;
-        break;
+    case FILTER_MODEL_A500: {
+	v4sf a1 = {a500e_filter1_a0, a500e_filter1_a0, a500e_filter1_a0, a500e_filter1_a0};
+	v4sf a2 = {a500e_filter2_a0, a500e_filter2_a0, a500e_filter2_a0, a500e_filter2_a0};
+	v4sf b1 = 1 - a1, b2 = 1 - a2;
+	for (i = 0; i < nframes; i++) {
+	    v4sf input = filter_block[i];
+	    rc1 = add_denormal_offset(a1 * input + b1 * rc1);
+	    rc2 = a2 * rc1 + b2 * rc2;
+	    rc3 = a0 * rc2 + b0 * rc3;
+	    rc4 = a0 * rc3 + b0 * rc4;
+	    rc5 = a0 * rc4 + b0 * rc5;
+	    filter_block[i] = filter_block_led ? rc5 : rc2;
+	}
+	break;
+    }
 
     case FILTER_MODEL_A1200:
-        normal_output = input;
-
-        fs->rc2 = filter_a0 * normal_output + (1 - filter_a0) * fs->rc2 + DENORMAL_OFFSET;
-        fs->rc3 = filter_a0 * fs->rc2       + (1 - filter_a0) * fs->rc3;
-        fs->rc4 = filter_a0 * fs->rc3       + (1 - filter_a0) * fs->rc4;
-
-        led_output = fs->rc4;
-        break;
+	for (i = 0; i < nframes; i++) {
+	    v4sf input = filter_block[i];
+	    rc2 = add_denormal_offset(a0 * input + b0 * rc2);
+	    rc3 = a0 * rc2 + b0 * rc3;
+	    rc4 = a0 * rc3 + b0 * rc4;
+	    if (filter_block_led)
+		filter_block[i] = rc4;
+	}
+	break;
 
     default:
 	fprintf(stderr, "Unknown filter mode\n");
 	exit(1);
     }
 
-    return clamp_sample(gui_ledstate ? led_output : normal_output);
+    sound_filter_state.rc1 = rc1;
+    sound_filter_state.rc2 = rc2;
+    sound_filter_state.rc3 = rc3;
+    sound_filter_state.rc4 = rc4;
+    sound_filter_state.rc5 = rc5;
+
+    for (i = 0; i < nframes; i++) {
+	for (nr = 0; nr < channels; nr++)
+	    p = store_sample_float(p, filter_block[i][nr]);
+    }
 }
 
 
@@ -139,11 +259,13 @@ static void check_sound_buffers (void)
     bytes = ((intptr_t) sndbufpt) - ((intptr_t) sndbuffer);
 
     if (uadecore_audio_output) {
-	if (bytes == uadecore_read_size) {
-	    uadecore_check_sound_buffers(uadecore_read_size);
-	    sndbufpt = sndbuffer;
+	if (bytes == uadecore_block_size) {
+	    audio_flush_filter();
+	    uadecore_check_sound_buffers(uadecore_block_size);
+	    sndbufpt = (uae_u8 *) sndbuffer;
 	}
     } else {
+	audio_flush_filter();
 	uadecore_audio_skip += bytes;
 	/* if sound core doesn't report audio output start in 3 seconds from
 	   the reboot, begin audio output anyway */
@@ -151,51 +273,86 @@ static void check_sound_buffers (void)
 	    fprintf(stderr, "involuntary audio output start\n");
 	    uadecore_audio_output = 1;
 	}
-	sndbufpt = sndbuffer;
+	sndbufpt = (uae_u8 *) sndbuffer;
     }
 }
 
 
-static inline void sample_backend(int left, int right)
+/* Mixes the voices to stereo, or outputs them one by one if separate
+   voices were requested. A voice is on the same scale as the stereo mix,
+   so the voices sum up to the stereo output. */
+static inline void sample_backend(const int *datas)
 {
+    int nr, left, right;
+
 #if AUDIO_DEBUG
-    int nr;
     for (nr = 0; nr < 4; nr++) {
 	struct audio_channel_data *cdp = audio_channel + nr;
-	if (cdp->state != 0 && cdp->datpt != 0 && (dmacon & (1 << nr)) && cdp->datpt >= cdp->datptend) {
-	    fprintf(stderr, "Audio output overrun on channel %d: %.8x/%.8x\n", nr, cdp->datpt, cdp->datptend);
+	struct audio_channel_debug *dbg = audio_channel_debug + nr;
+	if (cdp->state != 0 && dbg->datpt != 0 && (dmacon & (1 << nr)) && dbg->datpt >= dbg->datptend) {
+	    fprintf(stderr, "Audio output overrun on channel %d: %.8x/%.8x\n", nr, dbg->datpt, dbg->datptend);
 	}
     }
 #endif
 
+    if (sound_use_filter) {
+	v4sf *frame;
+	if (unlikely(gui_ledstate != filter_block_led)) {
+	    audio_flush_filter();
+	    filter_block_led = gui_ledstate;
+	}
+	frame = &filter_block[filter_block_frames++];
+	/* samples are in range -16384 (-128*64*2) and 16256 (127*64*2) */
+	if (unlikely(sound_separate_voices)) {
+	    *frame = (v4sf) {datas[0], datas[1], datas[2], datas[3]};
+	} else {
+	    *frame = (v4sf) {datas[0] + datas[3], datas[1] + datas[2], 0, 0};
+	}
+	*frame *= 1 << (16 - 14 - 1);
+	/* [-32768, 32512] */
+	sndbufpt += sound_bytes_per_frame;
+	check_sound_buffers();
+	return;
+    }
+
+    if (unlikely(sound_separate_voices)) {
+	for (nr = 0; nr < 4; nr++)
+	    put_sample(datas[nr] << (16 - 14 - 1));
+	check_sound_buffers();
+	return;
+    }
+
+    left = datas[0] + datas[3];
+    right = datas[1] + datas[2];
+
     /* samples are in range -16384 (-128*64*2) and 16256 (127*64*2) */
     left <<= 16 - 14 - 1;
     right <<= 16 - 14 - 1;
     /* [-32768, 32512] */
 
-    if (sound_use_filter) {
-	left = filter(left, &sound_filter_state[0]);
-	right = filter(right, &sound_filter_state[1]);
-    }
-
-    *(sndbufpt++) = left;
-    *(sndbufpt++) = right;
+    put_sample(left);
+    put_sample(right);
 
     check_sound_buffers();
 }
 
 
+/* The level that Paula outputs for the channel right now */
+static inline int channel_output(const struct audio_channel_data *acd)
+{
+    return (acd->current_sample * acd->vol) & acd->adk_mask;
+}
+
+
 static void sample16s_handler (void)
 {
     int datas[4];
     int i;
 
-    for (i = 0; i < 4; i++) {
-	datas[i] = audio_channel[i].current_sample * audio_channel[i].vol;
-	datas[i] &= audio_channel[i].adk_mask;
-    }
+    for (i = 0; i < 4; i++)
+	datas[i] = channel_output(&audio_channel[i]);
 
-    sample_backend(datas[0] + datas[3], datas[1] + datas[2]);
+    sample_backend(datas);
 }
 
 
@@ -207,12 +364,33 @@ static void sample16si_anti_handler (void)
     int datas[4];
 
     for (i = 0; i < 4; i += 1) {
-        datas[i] = audio_channel[i].sample_accum / audio_channel[i].sample_accum_time;
+	/* A silent voice needs no division */
+	if (audio_channel[i].sample_accum == 0)
+	    datas[i] = 0;
+	else
+	    datas[i] = audio_channel[i].sample_accum / audio_channel[i].sample_accum_time;
         audio_channel[i].sample_accum = 0;
 	audio_channel[i].sample_accum_time = 0;
     }
 
-    sample_backend(datas[0] + datas[3], datas[1] + datas[2]);
+    sample_backend(datas);
+}
+
+
+/* BLEPs include the filter, see sample_backend() for the mixing */
+static void sinc_backend(const int *datas)
+{
+    int i;
+
+    if (unlikely(sound_separate_voices)) {
+	for (i = 0; i < 4; i++)
+	    put_sample(datas[i]);
+    } else {
+	put_sample(datas[0] + datas[3]);
+	put_sample(datas[1] + datas[2]);
+    }
+
+    check_sound_buffers();
 }
 
 
@@ -234,70 +412,77 @@ static void sample16si_sinc_handler (void)
     winsinc = winsinc_integral[n];
     
     for (i = 0; i < 4; i += 1) {
-        int j;
-        struct audio_channel_data *acd = &audio_channel[i];
+        struct audio_channel_sinc *acs = &audio_channel_sinc[i];
+        int head = acs->queue_head;
         /* The sum rings with harmonic components up to infinity... */
-	int sum = acd->output_state << 17;
-        /* ...but we cancel them through mixing in BLEPs instead */
-        int offsetpos = acd->sinc_queue_head & (SINC_QUEUE_LENGTH - 1);
-        for (j = 0; j < SINC_QUEUE_LENGTH; j += 1) {
-            int age = acd->sinc_queue_time - acd->sinc_queue[offsetpos].time;
-            if (age >= SINC_QUEUE_MAX_AGE)
-                break;
-            sum -= winsinc[age] * acd->sinc_queue[offsetpos].output;
-            offsetpos = (offsetpos + 1) & (SINC_QUEUE_LENGTH - 1);
-        }
+	int sum = acs->output_state << 17;
+        /* ...but we cancel them through mixing in BLEPs instead. A voice
+           that has not changed for a whole BLEP has nothing to mix. */
+	if (acs->queue_time - acs->queue_times[head] < SINC_QUEUE_MAX_AGE)
+	    sum -= blep_sum(winsinc, acs->queue_times + head,
+			    acs->queue_outputs + head, acs->queue_time);
         datas[i] = sum >> 16;
     }
 
-    *(sndbufpt++) = clamp_sample(datas[0] + datas[3]);
-    *(sndbufpt++) = clamp_sample(datas[1] + datas[2]);
+    sinc_backend(datas);
+}
 
-    check_sound_buffers();
+
+static inline void anti_channel_prehandler(int nr, unsigned long best_evtime)
+{
+    struct audio_channel_data *acd = &audio_channel[nr];
+    int output = channel_output(acd);
+
+    acd->sample_accum += output * best_evtime;
+    acd->sample_accum_time += best_evtime;
 }
 
 
 static void anti_prehandler(unsigned long best_evtime)
 {
-    int i, j, output;
-    struct audio_channel_data *acd;
+    int i;
 
     /* Handle accumulator antialiasiation */
-    for (i = 0; i < 4; i++) {
-	acd = &audio_channel[i];
-	output = (acd->current_sample * acd->vol) & acd->adk_mask;
-	acd->sample_accum += output * best_evtime;
-	acd->sample_accum_time += best_evtime;
+    for (i = 0; i < 4; i++)
+	anti_channel_prehandler(i, best_evtime);
+}
+
+
+static inline void sinc_channel_prehandler(int nr, unsigned long best_evtime)
+{
+    struct audio_channel_data *acd = &audio_channel[nr];
+    struct audio_channel_sinc *acs = &audio_channel_sinc[nr];
+    int output = channel_output(acd);
+
+    /* if output state changes, record the state change and also
+     * write data into sinc queue for mixing in the BLEP */
+    if (acs->output_state != output) {
+        int head = (acs->queue_head - 1) & (SINC_QUEUE_LENGTH - 1);
+        acs->queue_head = head;
+        acs->queue_times[head] = acs->queue_time;
+        acs->queue_times[head + SINC_QUEUE_LENGTH] = acs->queue_time;
+        acs->queue_outputs[head] = output - acs->output_state;
+        acs->queue_outputs[head + SINC_QUEUE_LENGTH] = output - acs->output_state;
+        acs->output_state = output;
     }
+
+    acs->queue_time += best_evtime;
 }
 
 
 static void sinc_prehandler(unsigned long best_evtime)
 {
-    int i, j, output;
-    struct audio_channel_data *acd;
+    int i;
 
-    for (i = 0; i < 4; i++) {
-	acd = &audio_channel[i];
-	output = (acd->current_sample * acd->vol) & acd->adk_mask;
-
-        /* if output state changes, record the state change and also
-         * write data into sinc queue for mixing in the BLEP */
-        if (acd->output_state != output) {
-            acd->sinc_queue_head = (acd->sinc_queue_head - 1) & (SINC_QUEUE_LENGTH - 1);
-            acd->sinc_queue[acd->sinc_queue_head].time = acd->sinc_queue_time;
-            acd->sinc_queue[acd->sinc_queue_head].output = output - acd->output_state;
-            acd->output_state = output;
-        }
-        
-        acd->sinc_queue_time += best_evtime;
-    }
+    for (i = 0; i < 4; i++)
+	sinc_channel_prehandler(i, best_evtime);
 }
 
 
 static void audio_handler (int nr)
 {
     struct audio_channel_data *cdp = audio_channel + nr;
+    struct audio_channel_debug *dbg = audio_channel_debug + nr;
 
     switch (cdp->state) {
      case 0:
@@ -314,8 +499,8 @@ static void audio_handler (int nr)
 	    cdp->wlen = (cdp->wlen - 1) & 0xFFFF;
 	cdp->nextdat = chipmem_bank.wget(cdp->pt);
 
-	cdp->nextdatpt = cdp->pt;
-	cdp->nextdatptend = cdp->ptend;
+	dbg->nextdatpt = cdp->pt;
+	dbg->nextdatptend = dbg->ptend;
 
 	/* BUG in UAE. Only hsync handler should increase DMA pointer
 	   cdp->pt += 2;
@@ -327,8 +512,8 @@ static void audio_handler (int nr)
 	cdp->evtime = cdp->per;
 	cdp->dat = cdp->nextdat;
 
-	cdp->datpt = cdp->nextdatpt;
-	cdp->datptend = cdp->nextdatptend;
+	dbg->datpt = dbg->nextdatpt;
+	dbg->datptend = dbg->nextdatptend;
 
 	cdp->current_sample = (uae_s8)(cdp->dat >> 8);
 
@@ -358,8 +543,8 @@ static void audio_handler (int nr)
 
 	    cdp->dat = cdp->nextdat;
 
-	    cdp->datpt = cdp->nextdatpt;
-	    cdp->datptend = cdp->nextdatptend;
+	    dbg->datpt = dbg->nextdatpt;
+	    dbg->datptend = dbg->nextdatptend;
 
 	    if (cdp->dmaen)
 		cdp->data_written = 2;
@@ -394,8 +579,8 @@ static void audio_handler (int nr)
 
 	    cdp->dat = cdp->nextdat;
 
-	    cdp->datpt = cdp->nextdatpt;
-	    cdp->datptend = cdp->nextdatptend;
+	    dbg->datpt = dbg->nextdatpt;
+	    dbg->datptend = dbg->nextdatptend;
 
 	    cdp->current_sample = (uae_s8)(cdp->dat >> 8);
 
@@ -421,17 +606,22 @@ static void audio_handler (int nr)
 void audio_reset (void)
 {
     memset (audio_channel, 0, sizeof audio_channel);
+    memset (audio_channel_sinc, 0, sizeof audio_channel_sinc);
+    memset (audio_channel_debug, 0, sizeof audio_channel_debug);
     audio_channel[0].per = 65535;
     audio_channel[1].per = 65535;
     audio_channel[2].per = 65535;
     audio_channel[3].per = 65535;
 
     last_audio_cycles = 0;
-    next_sample_evtime = sample_evtime_interval;
+    audio_schedule_dirty = 1;
+    next_sample_cycles = sample_interval_cycles;
+    next_sample_frac = sample_interval_frac;
 
     audperhack = 0;
 
-    memset(sound_filter_state, 0, sizeof sound_filter_state);
+    audio_flush_filter();
+    memset(&sound_filter_state, 0, sizeof sound_filter_state);
 
     audio_set_resampler(NULL);
 
@@ -466,6 +656,7 @@ void audio_set_filter(int filter_type, int filter_force)
     fprintf(stderr, "Invalid filter number: %d\n", filter_type);
     exit(1);
   }
+  audio_flush_filter();
   sound_use_filter = filter_type;
 
   if (filter_force & 2) {
@@ -480,7 +671,12 @@ void audio_set_filter(int filter_type, int filter_force)
 
 void audio_set_rate(int rate)
 {
-    sample_evtime_interval = ((float) SOUNDTICKS) / rate;
+    /* Rescale the fraction so that the next sample stays where it was */
+    if (sample_rate != 0)
+	next_sample_frac = (uint64_t) next_sample_frac * rate / sample_rate;
+    sample_rate = rate;
+    sample_interval_cycles = SOUNDTICKS / rate;
+    sample_interval_frac = SOUNDTICKS % rate;
 
     /* Although these numbers are in Hz, these values should not be taken to
      * be the true filter cutoff values of Amiga 500 and Amiga 1200.
@@ -496,6 +692,7 @@ void audio_set_rate(int rate)
 
 void audio_set_resampler(char *name)
 {
+    audio_flush_filter();
     sample_handler = sample16si_anti_handler;
     sample_prehandler = anti_prehandler;
 
@@ -505,6 +702,7 @@ void audio_set_resampler(char *name)
     if (strcasecmp(name, "sinc") == 0) {
 	sample_handler = sample16si_sinc_handler;
 	sample_prehandler = sinc_prehandler;
+	blep_init();
     } else if (strcasecmp(name, "none") == 0) {
 	sample_handler = sample16s_handler;
 	sample_prehandler = NULL;
@@ -520,29 +718,92 @@ void audio_use_text_scope(void)
 }
 
 
-/* update_audio() emulates actions of audio state machine since it was last
-   time called. One can assume it is called at least once per horizontal
-   line and possibly more often. */
-void update_audio (void)
+/* Cycles from last_audio_cycles to the next transition of a channel that
+   raises or tests its interrupt request, or 0 if there is none before the
+   next hsync or register write updates the state machines anyway. The
+   other transitions only change the output and are emulated lazily. */
+static unsigned long audio_irq_evtime (int nr)
 {
-    /* Number of cycles that has passed since last call to update_audio() */
-    unsigned long n_cycles = cycles - last_audio_cycles;
+    struct audio_channel_data *cdp = audio_channel + nr;
+    int audav = adkcon & (1 << nr);
+    int audap = adkcon & (16 << nr);
+    int napnav = (!audav && !audap) || audav;
+    int irq3 = !cdp->dmaen || (cdp->intreq2 && napnav);
+
+    switch (cdp->state) {
+     case 1:
+	return cdp->evtime;
+     case 2:
+	if (audap && cdp->intreq2 && cdp->dmaen)
+	    return cdp->evtime;
+	return irq3 ? cdp->evtime + cdp->per : 0;
+     case 3:
+	return irq3 ? cdp->evtime : 0;
+     default:
+	return 0;
+    }
+}
+
+
+/* Put the interrupt deadlines of the channels into the event queue, so
+   that audio interrupts happen on time. */
+void audio_schedule (void)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+	struct ev *e = &eventtab[ev_audio0 + i];
+	unsigned long t = audio_irq_evtime (i);
+	if (t == 0) {
+	    if (e->active) {
+		e->active = 0;
+		event_reschedule (ev_audio0 + i);
+	    }
+	} else if (!e->active || e->evtime != last_audio_cycles + t) {
+	    e->active = 1;
+	    e->evtime = last_audio_cycles + t;
+	    event_reschedule (ev_audio0 + i);
+	}
+    }
+    audio_schedule_dirty = 0;
+}
+
+
+/* Bus cycles to the next output sample, rounded to nearest. The time is
+   at least -0.5 cycles, so this is never negative. */
+static inline unsigned long round_sample_evtime(void)
+{
+    return next_sample_cycles + (2 * next_sample_frac >= sample_rate);
+}
+
 
+static inline void advance_sample_evtime(void)
+{
+    next_sample_cycles += sample_interval_cycles;
+    next_sample_frac += sample_interval_frac;
+    if (next_sample_frac >= sample_rate) {
+	next_sample_frac -= sample_rate;
+	next_sample_cycles++;
+    }
+}
+
+
+/* Steps all four channels together from one event of any channel or
+   sample output to the next. Needed when channels are attached, because
+   then a channel's state machine modifies the next channel. */
+static void update_audio_steps(unsigned long n_cycles)
+{
     while (n_cycles > 0) {
 	unsigned long best_evtime = n_cycles + 1;
 	int i;
 	unsigned long rounded;
-	float f;
 
 	for (i = 0; i < 4; i++) {
 	    if (audio_channel[i].state != 0 && best_evtime > audio_channel[i].evtime)
 		best_evtime = audio_channel[i].evtime;
 	}
 
-	/* next_sample_evtime >= 0 so floor() behaves as expected */
-	rounded = floorf(next_sample_evtime);
-	if ((next_sample_evtime - rounded) >= 0.5)
-	    rounded++;
+	rounded = round_sample_evtime();
 
 	if (best_evtime > rounded)
 	    best_evtime = rounded;
@@ -551,7 +812,7 @@ void update_audio (void)
 	    best_evtime = n_cycles;
 	
 	/* Decrease time-to-wait counters */
-	next_sample_evtime -= best_evtime;
+	next_sample_cycles -= best_evtime;
 
 	/* sample_prehandler makes it possible to compute effects with
 	   accuracy of one bus cycle. sample_handler is only called when
@@ -566,9 +827,8 @@ void update_audio (void)
 
 	/* Test if new sample needs to be outputted */
 	if (rounded == best_evtime) {
-	    /* Before the following addition, next_sample_evtime is in range
-	       [-0.5, 0.5) */
-	    next_sample_evtime += sample_evtime_interval;
+	    /* Before advancing, the sample time is in range [-0.5, 0.5) */
+	    advance_sample_evtime();
 	    (*sample_handler) ();
 	}
 
@@ -578,27 +838,290 @@ void update_audio (void)
 		audio_handler(i);
 	}
     }
+}
+
+
+/* Returns 1 if the channel's state machine only toggles between the high
+   and the low byte of the same word until the next hsync: DMA is on, the
+   word in dat was already fetched again, and there is no interrupt to
+   raise. The attachment bits are off here, see update_audio(). */
+static inline int channel_repeats_word(const struct audio_channel_data *cdp)
+{
+    return (cdp->state == 2 || cdp->state == 3) && cdp->dmaen &&
+	!cdp->intreq2 && cdp->dat == cdp->nextdat;
+}
+
+
+/* Does what the run_channel() loop would do for a channel that repeats its
+   word, but in closed form. Very low periods toggle many times per output
+   sample, and this avoids an audio_handler() call for each toggle. The
+   accumulator gets the same sum as from the separate steps, unless
+   accumulate is 0 for an idle channel. */
+static void run_repeating_channel(int nr, unsigned long len, int accumulate)
+{
+    struct audio_channel_data *cdp = &audio_channel[nr];
+    struct audio_channel_debug *dbg = &audio_channel_debug[nr];
+    unsigned long t0 = cdp->evtime, per = cdp->per;
+    /* toggles strictly inside the span, the first one at t0 */
+    unsigned long n = (len - 1 - t0) / per + 1;
+    unsigned long rest = len - t0 - (n - 1) * per;
+    int hi = (uae_s8) (cdp->dat >> 8);
+    int lo = (uae_s8) (cdp->dat & 0xFF);
+    /* the bytes after odd and even numbers of toggles */
+    int odd = cdp->state == 2 ? lo : hi;
+    int even = cdp->state == 2 ? hi : lo;
+
+    if (accumulate && sample_prehandler == anti_prehandler) {
+	int output = channel_output(cdp);
+	int odd_output, even_output;
+	cdp->current_sample = odd;
+	odd_output = channel_output(cdp);
+	cdp->current_sample = even;
+	even_output = channel_output(cdp);
+
+	cdp->sample_accum += output * t0;
+	cdp->sample_accum += odd_output * per * (n / 2);
+	cdp->sample_accum += even_output * per * ((n - 1) / 2);
+	cdp->sample_accum += ((n & 1) ? odd_output : even_output) * rest;
+	cdp->sample_accum_time += len;
+    }
+
+    /* a 3->2 toggle reloads dat from nextdat, which is the same word */
+    if (n >= 2 || cdp->state == 3) {
+	cdp->data_written = 2;
+	dbg->datpt = dbg->nextdatpt;
+	dbg->datptend = dbg->nextdatptend;
+    }
+    if (n & 1) {
+	cdp->state = cdp->state == 2 ? 3 : 2;
+	cdp->current_sample = odd;
+    } else {
+	cdp->current_sample = even;
+    }
+    cdp->evtime = per - rest;
+}
+
+
+/* Runs one channel through len cycles, calling its state machine at each
+   event strictly inside the span. An event at the end of the span is left
+   at evtime 0 for the caller, which runs it after the sample that may end
+   there. */
+static inline void run_channel(int nr, unsigned long len)
+{
+    struct audio_channel_data *cdp = &audio_channel[nr];
+
+    while (cdp->state != 0 && cdp->evtime < len) {
+	unsigned long t = cdp->evtime;
+	/* The sinc resampler needs a BLEP for each toggle */
+	if (cdp->evtime + cdp->per < len && channel_repeats_word(cdp) &&
+	    sample_prehandler != sinc_prehandler) {
+	    run_repeating_channel(nr, len, 1);
+	    return;
+	}
+	if (sample_prehandler == anti_prehandler)
+	    anti_channel_prehandler(nr, t);
+	else if (sample_prehandler == sinc_prehandler)
+	    sinc_channel_prehandler(nr, t);
+	len -= t;
+	cdp->evtime = 0;
+	audio_handler(nr);
+    }
+    if (sample_prehandler == anti_prehandler)
+	anti_channel_prehandler(nr, len);
+    else if (sample_prehandler == sinc_prehandler)
+	sinc_channel_prehandler(nr, len);
+    cdp->evtime -= len;
+}
+
+
+/* Without attachment the channels only meet at the output samples. So each
+   sample period is rendered one channel at a time, which gives the same
+   result as update_audio_steps(): the prehandlers are linear in the span
+   length, and the sample clock is exact. */
+static void update_audio_span(unsigned long n_cycles)
+{
+    while (n_cycles > 0) {
+	unsigned long rounded = round_sample_evtime();
+	unsigned long len = rounded < n_cycles ? rounded : n_cycles;
+	int i;
+
+	next_sample_cycles -= len;
+
+	for (i = 0; i < 4; i++)
+	    run_channel(i, len);
+
+	n_cycles -= len;
+
+	if (rounded == len) {
+	    advance_sample_evtime();
+	    (*sample_handler) ();
+	}
+
+	for (i = 0; i < 4; i++) {
+	    if (audio_channel[i].evtime == 0 && audio_channel[i].state != 0)
+		audio_handler(i);
+	}
+    }
+}
 
-    last_audio_cycles = cycles - n_cycles;
+
+/* Returns 1 if the sample handler would output the current level of each
+   voice for the sample that is len cycles away. For the accumulator that
+   holds when the voices are level through the whole sample, and for the
+   BLEPs when the last change is at least a BLEP length old. */
+static int idle_voices_settled(unsigned long len)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+	struct audio_channel_data *acd = &audio_channel[i];
+	struct audio_channel_sinc *acs = &audio_channel_sinc[i];
+
+	if (sample_handler == sample16si_anti_handler) {
+	    if (acd->sample_accum_time != 0)
+		return 0;
+	} else if (sample_handler == sample16si_sinc_handler) {
+	    if (acs->output_state != channel_output(acd))
+		return 0;
+	    if (acs->queue_time + (int) len - acs->queue_times[acs->queue_head] < SINC_QUEUE_MAX_AGE)
+		return 0;
+	}
+    }
+    return 1;
+}
+
+
+/* Runs the state machine of a channel whose output does not change, see
+   channel_is_idle(). DMA fetches and interrupts still happen, but there is
+   nothing for the prehandlers to record. */
+static inline void run_idle_channel(int nr, unsigned long len)
+{
+    struct audio_channel_data *cdp = &audio_channel[nr];
+
+    while (cdp->state != 0 && cdp->evtime < len) {
+	if (cdp->evtime + cdp->per < len && channel_repeats_word(cdp)) {
+	    run_repeating_channel(nr, len, 0);
+	    return;
+	}
+	len -= cdp->evtime;
+	cdp->evtime = 0;
+	audio_handler(nr);
+    }
+    cdp->evtime -= len;
+}
+
+
+/* When every channel is stopped or plays at volume 0, Paula's output can
+   only change at a register write, and update_audio() runs before each of
+   those. Once the voices have settled, every sample until the end of the
+   span is the same. They are output without the prehandler and sample
+   handler work, and the state machines of the zero volume channels only
+   run their events. The filter still runs, so its tail decays as before.
+   Song intros, gaps and ends spend most time here. */
+static void update_audio_idle(unsigned long n_cycles)
+{
+    int datas[4];
+    int i, settled = 0;
+
+    while (n_cycles > 0) {
+	unsigned long rounded = round_sample_evtime();
+	unsigned long len = rounded < n_cycles ? rounded : n_cycles;
+
+	next_sample_cycles -= len;
+	n_cycles -= len;
+
+	if (rounded == len && !settled && idle_voices_settled(len)) {
+	    settled = 1;
+	    for (i = 0; i < 4; i++) {
+		datas[i] = channel_output(&audio_channel[i]);
+		/* see sample16si_sinc_handler() */
+		if (sample_handler == sample16si_sinc_handler)
+		    datas[i] = (datas[i] << 17) >> 16;
+	    }
+	}
+
+	if (rounded != len || !settled) {
+	    for (i = 0; i < 4; i++)
+		run_channel(i, len);
+	    if (rounded == len) {
+		advance_sample_evtime();
+		(*sample_handler) ();
+	    }
+	} else {
+	    for (i = 0; i < 4; i++)
+		run_idle_channel(i, len);
+	    advance_sample_evtime();
+	    if (sample_handler == sample16si_sinc_handler) {
+		for (i = 0; i < 4; i++)
+		    audio_channel_sinc[i].queue_time += len;
+		sinc_backend(datas);
+	    } else {
+		sample_backend(datas);
+	    }
+	}
+
+	for (i = 0; i < 4; i++) {
+	    if (audio_channel[i].evtime == 0 && audio_channel[i].state != 0)
+		audio_handler(i);
+	}
+    }
+}
+
+
+/* Returns 1 if the channel's output can not change before the next
+   register write. Without attachment only AUDxVOL changes the volume, so
+   a channel at volume 0 stays silent even if its DMA keeps running. */
+static inline int channel_is_idle(const struct audio_channel_data *acd)
+{
+    return acd->state == 0 || (acd->vol == 0 && !(adkcon & 0xff));
+}
+
+
+/* update_audio() emulates actions of audio state machine since it was last
+   time called. It is called at least once per horizontal line, at each
+   audio interrupt deadline and before each audio register write that
+   affects the state machines. Writes within one CPU instruction happen at
+   the same cycle, so e.g. a movem to AUDxLC..AUDxVOL only catches up once. */
+void update_audio (void)
+{
+    /* Number of cycles that has passed since last call to update_audio() */
+    unsigned long n_cycles = cycles - last_audio_cycles;
+
+    if (n_cycles == 0 && !audio_schedule_dirty)
+	return;
+
+    if (channel_is_idle(&audio_channel[0]) && channel_is_idle(&audio_channel[1]) &&
+	channel_is_idle(&audio_channel[2]) && channel_is_idle(&audio_channel[3]))
+	update_audio_idle(n_cycles);
+    /* ADKCON bits 0-7 attach a channel's volume or period to the next */
+    else if (adkcon & 0xff)
+	update_audio_steps(n_cycles);
+    else
+	update_audio_span(n_cycles);
+
+    last_audio_cycles = cycles;
+    audio_schedule ();
 }
 
 
 void AUDxDAT (int nr, uae_u16 v)
 {
     struct audio_channel_data *cdp = audio_channel + nr;
+    struct audio_channel_debug *dbg = audio_channel_debug + nr;
 
     TEXT_SCOPE(cycles, nr, PET_DAT, v);
 
     update_audio ();
 
     cdp->dat = v;
-    cdp->datpt = 0;
+    dbg->datpt = 0;
 
     if (cdp->state == 0 && !(INTREQR() & (0x80 << nr))) {
 	cdp->state = 2;
 	INTREQ(0x8000 | (0x80 << nr));
 	/* data_written = 2 ???? */
 	cdp->evtime = cdp->per;
+	audio_schedule ();
     }
 }
 
@@ -607,7 +1130,7 @@ void AUDxLCH (int nr, uae_u16 v)
 {
     TEXT_SCOPE(cycles, nr, PET_LCH, v);
 
-    update_audio ();
+    /* lc and len are only used at DMA fetches, no update_audio() needed */
 
     audio_channel[nr].lc = (audio_channel[nr].lc & 0xffff) | ((uae_u32)v << 16);
 }
@@ -617,12 +1140,31 @@ void AUDxLCL (int nr, uae_u16 v)
 {
     TEXT_SCOPE(cycles, nr, PET_LCL, v);
 
-    update_audio ();
-
     audio_channel[nr].lc = (audio_channel[nr].lc & ~0xffff) | (v & 0xFFFE);
 }
 
 
+/* Robocop customs, for example, use periods below 16. They are emulated
+   as they are, and run_repeating_channel() keeps them cheap with the
+   accumulator. The sinc queue holds SINC_QUEUE_LENGTH BLEPs, so with the
+   2048 cycle tables the period must be at least 8. period_clamp gives the
+   old limit of 16 for slow machines, with the risk of breaking players. */
+static int audio_min_period(void)
+{
+    if (period_clamp)
+	return 16;
+    if (sample_prehandler == sinc_prehandler)
+	return (SINC_QUEUE_MAX_AGE + SINC_QUEUE_LENGTH - 1) / SINC_QUEUE_LENGTH;
+    return 1;
+}
+
+
+void audio_set_period_clamp(int clamp)
+{
+    period_clamp = clamp;
+}
+
+
 void AUDxPER (int nr, uae_u16 v)
 {
     TEXT_SCOPE(cycles, nr, PET_PER, v);
@@ -631,17 +1173,15 @@ void AUDxPER (int nr, uae_u16 v)
 
     if (v == 0)
 	v = 65535;
-    else if (v < 16) {
-	/* With the risk of breaking super-cool players,
-	   we limit the value to 16 to save cpu time on not so powerful
-	   machines. robocop customs use low values for example. */
+    else if (v < audio_min_period()) {
 	if (!audperhack) {
 	    audperhack = 1;
 	    uadecore_send_debug("Eagleplayer inserted %d into aud%dper.", v, nr);
 	}
-	v = 16;
+	v = audio_min_period();
     }
     audio_channel[nr].per = v;
+    audio_schedule_dirty = 1;
 }
 
 
@@ -649,8 +1189,6 @@ void AUDxLEN (int nr, uae_u16 v)
 {
     TEXT_SCOPE(cycles, nr, PET_LEN, v);
 
-    update_audio ();
-
     audio_channel[nr].len = v;
 }
 
@@ -0,0 +1,131 @@
+ /*
+  * UADE's BLEP mixing kernels for the sinc resampler
+  *
+  * The plain C version is the reference. The SSE2 and AVX2 versions give
+  * bit identical results: all arithmetic is on 32-bit integers, and the
+  * lane sums wrap the same way as the scalar sum does. The fastest version
+  * that the CPU supports is picked at run time by blep_init().
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include "audio.h"
+#include "sinctable.h"
+#include "blep.h"
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define BLEP_X86 1
+#include <immintrin.h>
+#endif
+
+blep_sum_func blep_sum;
+
+static int blep_sum_c (const int *winsinc, const int *times,
+		       const int *outputs, int now)
+{
+    int k, sum = 0;
+
+    for (k = 0; k < SINC_QUEUE_LENGTH; k++) {
+	int age = now - times[k];
+	if (age >= SINC_QUEUE_MAX_AGE)
+	    break;
+	sum += winsinc[age] * outputs[k];
+    }
+    return sum;
+}
+
+#ifdef BLEP_X86
+
+/* Number of queue entries younger than SINC_QUEUE_MAX_AGE */
+static int blep_count_sse2 (const int *times, int now)
+{
+    __m128i vnow = _mm_set1_epi32 (now);
+    __m128i vmax = _mm_set1_epi32 (SINC_QUEUE_MAX_AGE - 1);
+    int k, old;
+
+    for (k = 0; k < SINC_QUEUE_LENGTH; k += 4) {
+	__m128i age = _mm_sub_epi32 (vnow, _mm_loadu_si128 ((const __m128i *) (times + k)));
+	old = _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpgt_epi32 (age, vmax)));
+	if (old)
+	    return k + __builtin_ctz (old);
+    }
+    return SINC_QUEUE_LENGTH;
+}
+
+static int blep_sum_sse2 (const int *winsinc, const int *times,
+			  const int *outputs, int now)
+{
+    int n = blep_count_sse2 (times, now);
+    __m128i acc = _mm_setzero_si128 ();
+    int k, sum;
+
+    for (k = 0; k + 4 <= n; k += 4) {
+	/* SSE2 has no gather and no 32-bit mullo: load the table values
+	   one by one and multiply the even and odd lanes separately */
+	__m128i w = _mm_set_epi32 (winsinc[now - times[k + 3]],
+				   winsinc[now - times[k + 2]],
+				   winsinc[now - times[k + 1]],
+				   winsinc[now - times[k]]);
+	__m128i o = _mm_loadu_si128 ((const __m128i *) (outputs + k));
+	__m128i even = _mm_mul_epu32 (w, o);
+	__m128i odd = _mm_mul_epu32 (_mm_srli_epi64 (w, 32), _mm_srli_epi64 (o, 32));
+	__m128i prod = _mm_unpacklo_epi32 (_mm_shuffle_epi32 (even, _MM_SHUFFLE (0, 0, 2, 0)),
+					   _mm_shuffle_epi32 (odd, _MM_SHUFFLE (0, 0, 2, 0)));
+	acc = _mm_add_epi32 (acc, prod);
+    }
+    acc = _mm_add_epi32 (acc, _mm_shuffle_epi32 (acc, _MM_SHUFFLE (1, 0, 3, 2)));
+    acc = _mm_add_epi32 (acc, _mm_shuffle_epi32 (acc, _MM_SHUFFLE (2, 3, 0, 1)));
+    sum = _mm_cvtsi128_si32 (acc);
+
+    for (; k < n; k++)
+	sum += winsinc[now - times[k]] * outputs[k];
+    return sum;
+}
+
+__attribute__ ((target ("avx2")))
+static int blep_sum_avx2 (const int *winsinc, const int *times,
+			  const int *outputs, int now)
+{
+    __m256i vnow = _mm256_set1_epi32 (now);
+    __m256i vmax = _mm256_set1_epi32 (SINC_QUEUE_MAX_AGE - 1);
+    __m256i acc = _mm256_setzero_si256 ();
+    __m128i acc4;
+    int k, old, sum;
+
+    for (k = 0; k < SINC_QUEUE_LENGTH; k += 8) {
+	__m256i age = _mm256_sub_epi32 (vnow, _mm256_loadu_si256 ((const __m256i *) (times + k)));
+	__m256i o = _mm256_loadu_si256 ((const __m256i *) (outputs + k));
+	old = _mm256_movemask_ps (_mm256_castsi256_ps (_mm256_cmpgt_epi32 (age, vmax)));
+	if (old) {
+	    /* Only the lanes before the first old entry count. The masked
+	       gather does not touch the table for the other lanes. */
+	    int live = (old & -old) - 1;
+	    __m256i lanes = _mm256_set_epi32 (128, 64, 32, 16, 8, 4, 2, 1);
+	    __m256i mask = _mm256_cmpgt_epi32 (_mm256_and_si256 (lanes, _mm256_set1_epi32 (live)),
+					       _mm256_setzero_si256 ());
+	    __m256i w = _mm256_mask_i32gather_epi32 (_mm256_setzero_si256 (), winsinc, age, mask, 4);
+	    acc = _mm256_add_epi32 (acc, _mm256_mullo_epi32 (w, o));
+	    break;
+	}
+	acc = _mm256_add_epi32 (acc, _mm256_mullo_epi32 (_mm256_i32gather_epi32 (winsinc, age, 4), o));
+    }
+    acc4 = _mm_add_epi32 (_mm256_castsi256_si128 (acc), _mm256_extracti128_si256 (acc, 1));
+    acc4 = _mm_add_epi32 (acc4, _mm_shuffle_epi32 (acc4, _MM_SHUFFLE (1, 0, 3, 2)));
+    acc4 = _mm_add_epi32 (acc4, _mm_shuffle_epi32 (acc4, _MM_SHUFFLE (2, 3, 0, 1)));
+    sum = _mm_cvtsi128_si32 (acc4);
+    return sum;
+}
+
+#endif /* BLEP_X86 */
+
+void blep_init (void)
+{
+    blep_sum = blep_sum_c;
+#ifdef BLEP_X86
+    blep_sum = blep_sum_sse2;
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2"))
+	blep_sum = blep_sum_avx2;
+#endif
+}
@@ -32,6 +32,8 @@ static struct cfg_lines opttable[] =
     {"cpu_speed", "can be max, real, or a number between 1 and 20" },
     {"cpu_type", "Can be 68000, 68010, 68020, 68020/68881" },
     {"cpu_compatible", "yes enables compatibility-mode" },
+    {"cpu_predecode", "yes enables the predecoded instruction cache" },
+    {"cpu_jit", "yes translates hot code to x86-64 code" },
     {"cpu_24bit_addressing", "must be set to 'no' in order for Z3mem or P96mem to work" },
     {"autoconfig", "yes = add filesystems and extra ram" },
     {"accuracy", "emulation accuracy, default is 2" },
@@ -212,6 +214,8 @@ void save_options (FILE *f, struct uae_prefs *p)
 
     fprintf (f, "cpu_type=%s\n", cpumode[p->cpu_level * 2 + !p->address_space_24]);
     fprintf (f, "cpu_compatible=%s\n", p->cpu_compatible ? "true" : "false");
+    fprintf (f, "cpu_predecode=%s\n", p->cpu_predecode ? "true" : "false");
+    fprintf (f, "cpu_jit=%s\n", p->cpu_jit ? "true" : "false");
     fprintf (f, "autoconfig=%s\n", p->automount_uaedev ? "true" : "false");
 
     fprintf (f, "accuracy=%d\n", p->emul_accuracy);
@@ -333,6 +337,8 @@ int cfgfile_parse_option (struct uae_prefs *p, char *option, char *value)
 	|| cfgfile_yesno (option, value, "gfx_fullscreen_picasso", &p->gfx_pfullscreen)
 	|| cfgfile_yesno (option, value, "ntsc", &p->ntscmode)
 	|| cfgfile_yesno (option, value, "cpu_compatible", &p->cpu_compatible)
+	|| cfgfile_yesno (option, value, "cpu_predecode", &p->cpu_predecode)
+	|| cfgfile_yesno (option, value, "cpu_jit", &p->cpu_jit)
 	|| cfgfile_yesno (option, value, "cpu_24bit_addressing", &p->address_space_24)
 	|| cfgfile_yesno (option, value, "autoconfig", &p->automount_uaedev)
 	|| cfgfile_yesno (option, value, "parallel_on_demand", &p->parallel_demand)
@@ -665,6 +665,7 @@ static uae_u32 REGPARAM2 cia_wget (uaecptr addr)
 
 static uae_u32 REGPARAM2 cia_bget (uaecptr addr)
 {
+    unstable_reads++;
     if ((addr & 0x3001) == 0x2001)
 	return ReadCIAA((addr & 0xF00) >> 8);
     if ((addr & 0x3001) == 0x1000)
@@ -719,6 +720,7 @@ static uae_u32 REGPARAM2 clock_bget (uaecptr addr)
 {
     time_t t = time(NULL);
     struct tm *ct;
+    unstable_reads++;
     ct=localtime(&t);
     switch (addr & 0x3f)
     {
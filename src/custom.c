@@ -45,6 +45,128 @@ unsigned long int cycles, nextevent, is_lastline;
 static int rpt_did_reset;
 struct ev eventtab[ev_max];
 
+/* Event queue. evheap_pos[] is the heap index of an event, or -1 if it
+ * is not queued. The copper, blitter and disk events are never queued:
+ * the copper runs synchronously from the custom register accessors. */
+static int evheap[ev_max], evheap_pos[ev_max], evheap_n;
+
+static int event_queued (int ev)
+{
+    return eventtab[ev].active && ev != ev_copper && ev != ev_blitter
+	&& ev != ev_diskblk && ev != ev_diskindex;
+}
+
+static int event_before (int a, int b)
+{
+    unsigned long int ta = eventtab[a].evtime - cycles;
+    unsigned long int tb = eventtab[b].evtime - cycles;
+    return ta < tb || (ta == tb && a < b);
+}
+
+static void evheap_set (int i, int ev)
+{
+    evheap[i] = ev;
+    evheap_pos[ev] = i;
+}
+
+static void evheap_up (int i)
+{
+    int ev = evheap[i];
+    while (i > 0 && event_before (ev, evheap[(i - 1) / 2])) {
+	evheap_set (i, evheap[(i - 1) / 2]);
+	i = (i - 1) / 2;
+    }
+    evheap_set (i, ev);
+}
+
+static void evheap_down (int i)
+{
+    int ev = evheap[i];
+    for (;;) {
+	int c = 2 * i + 1;
+	if (c >= evheap_n)
+	    break;
+	if (c + 1 < evheap_n && event_before (evheap[c + 1], evheap[c]))
+	    c++;
+	if (!event_before (evheap[c], ev))
+	    break;
+	evheap_set (i, evheap[c]);
+	i = c;
+    }
+    evheap_set (i, ev);
+}
+
+static void evheap_nextevent (void)
+{
+    /* With no events at all nextevent is as far away as possible */
+    nextevent = evheap_n ? eventtab[evheap[0]].evtime : cycles - 1;
+}
+
+void events_schedule (void)
+{
+    int ev, i;
+
+    evheap_n = 0;
+    for (ev = 0; ev < ev_max; ev++) {
+	evheap_pos[ev] = -1;
+	if (event_queued (ev))
+	    evheap_set (evheap_n++, ev);
+    }
+    for (i = evheap_n / 2 - 1; i >= 0; i--)
+	evheap_down (i);
+    evheap_nextevent ();
+}
+
+static void evheap_remove (int ev)
+{
+    int i = evheap_pos[ev];
+
+    evheap_pos[ev] = -1;
+    if (i != --evheap_n) {
+	int last = evheap[evheap_n];
+	evheap_set (i, last);
+	evheap_up (i);
+	evheap_down (evheap_pos[last]);
+    }
+}
+
+void event_reschedule (int ev)
+{
+    int i = evheap_pos[ev];
+
+    if (!event_queued (ev)) {
+	if (i >= 0)
+	    evheap_remove (ev);
+    } else if (i < 0) {
+	evheap_set (evheap_n, ev);
+	evheap_up (evheap_n++);
+    } else {
+	evheap_up (i);
+	evheap_down (evheap_pos[ev]);
+    }
+    evheap_nextevent ();
+}
+
+/* Fire all events that are due at the current cycle. An event is taken
+ * out of the heap while its handler runs, because the handler moves it
+ * and may reschedule other events meanwhile. Each event fires at most
+ * once, even if its handler leaves it at the current cycle. */
+void events_fire (void)
+{
+    int fired = 0;
+
+    while (evheap_n > 0) {
+	int ev = evheap[0];
+	if (eventtab[ev].evtime != cycles || (fired & (1 << ev)))
+	    break;
+	fired |= 1 << ev;
+	evheap_remove (ev);
+	(*eventtab[ev].handler) ();
+	event_reschedule (ev);
+    }
+    evheap_nextevent ();
+}
+
 static int vpos;
 static uae_u16 lof;
 static int next_lineno;
@@ -59,6 +181,7 @@ static uae_u32 sprtaba[256],sprtabb[256];
  */
 
 static void custom_wput_1 (int, uaecptr, uae_u32) REGPARAM;
+static void init_custom_wput_tbl (void);
 
 static uae_u16 cregs[256];
 
@@ -428,13 +551,14 @@ static void DMACON (uae_u16 v)
 
     for (i = 0; i < 4; i++) {
 	struct audio_channel_data *cdp = audio_channel + i;
+	struct audio_channel_debug *dbg = audio_channel_debug + i;
 
 	cdp->dmaen = (dmacon & 0x200) && (dmacon & (1<<i));
 	if (cdp->dmaen) {
 	    if (cdp->state == 0) {
 		cdp->state = 1;
 		cdp->pt = cdp->lc;
-		cdp->ptend = cdp->lc + 2 * (cdp->len ? cdp->len : 65536);
+		dbg->ptend = cdp->lc + 2 * (cdp->len ? cdp->len : 65536);
 		cdp->wper = cdp->per;
 		cdp->wlen = cdp->len;
 		cdp->data_written = 2;
@@ -448,6 +572,7 @@ static void DMACON (uae_u16 v)
 	}
     }
 
+    audio_schedule ();
     events_schedule();
 }
 
@@ -477,6 +602,7 @@ static void ADKCON (uae_u16 v)
     audio_channel[1].adk_mask = (((t >> 1) & 1) - 1);
     audio_channel[2].adk_mask = (((t >> 2) & 1) - 1);
     audio_channel[3].adk_mask = (((t >> 3) & 1) - 1);
+    audio_schedule_dirty = 1;
 }
 
 static void BEAMCON0 (uae_u16 v)
@@ -1246,20 +1372,21 @@ static void hsync_handler (void)
     /* Sound data is fetched at the beginning of each line */
     for (nr = 0; nr < 4; nr++) {
 	struct audio_channel_data *cdp = audio_channel + nr;
+	struct audio_channel_debug *dbg = audio_channel_debug + nr;
 
 	if (cdp->data_written == 2) {
 	    cdp->data_written = 0;
 
 #if AUDIO_DEBUG	   
-	    if (cdp->state != 0 && cdp->pt >= cdp->ptend) {
-		fprintf(stderr, "Audio DMA fetch overrun on channel %d: %.8x/%.8x\n", nr, cdp->pt, cdp->ptend);
+	    if (cdp->state != 0 && cdp->pt >= dbg->ptend) {
+		fprintf(stderr, "Audio DMA fetch overrun on channel %d: %.8x/%.8x\n", nr, cdp->pt, dbg->ptend);
 	    }
 #endif
 
 	    cdp->nextdat = chipmem_bank.wget(cdp->pt);
 
-	    cdp->nextdatpt = cdp->pt;
-	    cdp->nextdatptend = cdp->ptend;
+	    dbg->nextdatpt = cdp->pt;
+	    dbg->nextdatptend = dbg->ptend;
 
 	    if (cdp->wlen != 1)
 		cdp->pt += 2;
@@ -1267,9 +1394,10 @@ static void hsync_handler (void)
 	    if (cdp->state == 2 || cdp->state == 3) {
 		if (cdp->wlen == 1) {
 		    cdp->pt = cdp->lc;
-		    cdp->ptend = cdp->lc + 2 * (cdp->len ? cdp->len : 65536);
+		    dbg->ptend = cdp->lc + 2 * (cdp->len ? cdp->len : 65536);
 		    cdp->wlen = cdp->len;
 		    cdp->intreq2 = 1;
+		    audio_schedule_dirty = 1;
 		} else {
 		    cdp->wlen = (cdp->wlen - 1) & 0xFFFF;
 		}
@@ -1299,6 +1427,8 @@ static void init_eventtab (void)
     eventtab[ev_hsync].handler = hsync_handler;
     eventtab[ev_hsync].evtime = maxhpos + cycles;
     eventtab[ev_hsync].active = 1;
+    for (i = 0; i < 4; i++)
+	eventtab[ev_audio0 + i].handler = update_audio;
 
     events_schedule ();
 }
@@ -1400,6 +1530,7 @@ static void gen_custom_tables (void)
 void custom_init (void)
 {
     gen_custom_tables ();
+    init_custom_wput_tbl ();
 }
 
 /* Custom chip memory bank */
@@ -1417,11 +1548,23 @@ addrbank custom_bank = {
     default_xlate, default_check
 };
 
+uae_u32 unstable_reads;
+
 static uae_u32 REGPARAM2 custom_wget (uaecptr addr)
 {
     switch (addr & 0x1FE) {
-     case 0x002: return DMACONR();
-     case 0x004: return VPOSR();
+     /* These only change at events or on writes, see idle_poll() */
+     case 0x002: regs.spcflags |= SPCFLAG_POLL; return DMACONR();
+     case 0x004: regs.spcflags |= SPCFLAG_POLL; return VPOSR();
+     case 0x010: regs.spcflags |= SPCFLAG_POLL; return ADKCONR();
+     case 0x01C: regs.spcflags |= SPCFLAG_POLL; return INTENAR();
+     case 0x01E: regs.spcflags |= SPCFLAG_POLL; return INTREQR();
+     default:
+	break;
+    }
+
+    unstable_reads++;
+    switch (addr & 0x1FE) {
      case 0x006: return VHPOSR();
 
      case 0x008: return DSKDATR();
@@ -1429,13 +1572,10 @@ static uae_u32 REGPARAM2 custom_wget (uaecptr addr)
      case 0x00A: return JOY0DAT();
      case 0x00C: return JOY1DAT();
      case 0x00E: return CLXDAT();
-     case 0x010: return ADKCONR();
 
      case 0x012: return POT0DAT();
      case 0x016: return POTGOR();
      case 0x01A: return DSKBYTR();
-     case 0x01C: return INTENAR();
-     case 0x01E: return INTREQR();
      case 0x07C: return DENISEID();
      default:
        //        fprintf(stderr,"Non-read register read in custom chipset ($dff%x)",addr);
@@ -1454,172 +1594,187 @@ static uae_u32 REGPARAM2 custom_lget (uaecptr addr)
     return ((uae_u32)custom_wget(addr & 0xfffe) << 16) | custom_wget((addr+2) & 0xfffe);
 }
 
-static void REGPARAM2 custom_wput_1 (int hpos, uaecptr addr, uae_u32 value)
+/* Register writes are dispatched through a table indexed by the register
+   number. Each entry has a wrapper with a common signature and the channel,
+   plane or sprite number it applies to. */
+
+typedef void (*custom_wput_func) (int hpos, int num, uae_u16 v);
+
+static struct custom_wput_handler {
+    custom_wput_func func;
+    int num;
+} custom_wput_tbl[256];
+
+#define CUSTOM_W(reg) \
+    static void cw_##reg (int hpos, int num, uae_u16 v) { reg (v); }
+#define CUSTOM_W_HPOS(reg) \
+    static void cw_##reg (int hpos, int num, uae_u16 v) { reg (hpos, v); }
+#define CUSTOM_W_NUM(reg) \
+    static void cw_##reg (int hpos, int num, uae_u16 v) { reg (num, v); }
+#define CUSTOM_W_HPOS_NUM(reg) \
+    static void cw_##reg (int hpos, int num, uae_u16 v) { reg (hpos, v, num); }
+
+CUSTOM_W (DSKPTH) CUSTOM_W (DSKPTL) CUSTOM_W (DSKLEN) CUSTOM_W (DSKDAT)
+CUSTOM_W (VPOSW) CUSTOM_W (COPCON) CUSTOM_W (POTGO)
+CUSTOM_W (BLTCON0) CUSTOM_W (BLTCON1) CUSTOM_W (BLTAFWM) CUSTOM_W (BLTALWM)
+CUSTOM_W (BLTAPTH) CUSTOM_W (BLTAPTL) CUSTOM_W (BLTBPTH) CUSTOM_W (BLTBPTL)
+CUSTOM_W (BLTCPTH) CUSTOM_W (BLTCPTL) CUSTOM_W (BLTDPTH) CUSTOM_W (BLTDPTL)
+CUSTOM_W (BLTSIZE)
+CUSTOM_W (BLTAMOD) CUSTOM_W (BLTBMOD) CUSTOM_W (BLTCMOD) CUSTOM_W (BLTDMOD)
+CUSTOM_W (BLTCDAT) CUSTOM_W (BLTBDAT) CUSTOM_W (BLTADAT)
+CUSTOM_W (DSKSYNC)
+CUSTOM_W (COP1LCH) CUSTOM_W (COP1LCL) CUSTOM_W (COP2LCH) CUSTOM_W (COP2LCL)
+CUSTOM_W (COPJMP1) CUSTOM_W (COPJMP2)
+CUSTOM_W_HPOS (DIWSTRT) CUSTOM_W_HPOS (DIWSTOP)
+CUSTOM_W_HPOS (DDFSTRT) CUSTOM_W_HPOS (DDFSTOP)
+CUSTOM_W (DMACON) CUSTOM_W (CLXCON) CUSTOM_W (INTENA) CUSTOM_W (INTREQ)
+CUSTOM_W (ADKCON)
+CUSTOM_W_NUM (AUDxLCH) CUSTOM_W_NUM (AUDxLCL) CUSTOM_W_NUM (AUDxLEN)
+CUSTOM_W_NUM (AUDxPER) CUSTOM_W_NUM (AUDxVOL) CUSTOM_W_NUM (AUDxDAT)
+CUSTOM_W_HPOS_NUM (BPLPTH) CUSTOM_W_HPOS_NUM (BPLPTL)
+CUSTOM_W_HPOS (BPLCON0) CUSTOM_W_HPOS (BPLCON1)
+CUSTOM_W_HPOS (BPLCON2) CUSTOM_W_HPOS (BPLCON3) CUSTOM_W_HPOS (BPLCON4)
+CUSTOM_W_HPOS (BPL1MOD) CUSTOM_W_HPOS (BPL2MOD)
+CUSTOM_W (BPL1DAT) CUSTOM_W (BPL2DAT) CUSTOM_W (BPL3DAT) CUSTOM_W (BPL4DAT)
+CUSTOM_W (BPL5DAT) CUSTOM_W (BPL6DAT) CUSTOM_W (BPL7DAT) CUSTOM_W (BPL8DAT)
+CUSTOM_W_HPOS_NUM (SPRxPTH) CUSTOM_W_HPOS_NUM (SPRxPTL)
+CUSTOM_W_HPOS_NUM (SPRxPOS) CUSTOM_W_HPOS_NUM (SPRxCTL)
+CUSTOM_W_HPOS_NUM (SPRxDATA) CUSTOM_W_HPOS_NUM (SPRxDATB)
+CUSTOM_W (JOYTEST) CUSTOM_W (BLTCON0L) CUSTOM_W (BLTSIZV) CUSTOM_W (BLTSIZH)
+CUSTOM_W_HPOS (DIWHIGH) CUSTOM_W (FMODE)
+CUSTOM_W (BEAMCON0)
+
+static void cw_COLOR (int hpos, int num, uae_u16 v) { COLOR (hpos, v & 0xFFF, num); }
+static void cw_none (int hpos, int num, uae_u16 v) { }
+
+static void set_custom_wput (uaecptr addr, custom_wput_func func, int num)
+{
+    custom_wput_tbl[addr >> 1].func = func;
+    custom_wput_tbl[addr >> 1].num = num;
+}
+
+static void init_custom_wput_tbl (void)
 {
-    addr &= 0x1FE;
-    switch (addr) {
-     case 0x020: DSKPTH (value); break;
-     case 0x022: DSKPTL (value); break;
-     case 0x024: DSKLEN (value); break;
-     case 0x026: DSKDAT (value); break;
-
-     case 0x02A: VPOSW (value); break;
-     case 0x2E:  COPCON (value); break;
-     case 0x34: POTGO (value); break;
-     case 0x040: BLTCON0 (value); break;
-     case 0x042: BLTCON1 (value); break;
-
-     case 0x044: BLTAFWM (value); break;
-     case 0x046: BLTALWM (value); break;
-
-     case 0x050: BLTAPTH (value); break;
-     case 0x052: BLTAPTL (value); break;
-     case 0x04C: BLTBPTH (value); break;
-     case 0x04E: BLTBPTL (value); break;
-     case 0x048: BLTCPTH (value); break;
-     case 0x04A: BLTCPTL (value); break;
-     case 0x054: BLTDPTH (value); break;
-     case 0x056: BLTDPTL (value); break;
-
-     case 0x058: BLTSIZE (value); break;
-
-     case 0x064: BLTAMOD (value); break;
-     case 0x062: BLTBMOD (value); break;
-     case 0x060: BLTCMOD (value); break;
-     case 0x066: BLTDMOD (value); break;
-
-     case 0x070: BLTCDAT (value); break;
-     case 0x072: BLTBDAT (value); break;
-     case 0x074: BLTADAT (value); break;
-
-     case 0x07E: DSKSYNC (value); break;
-
-     case 0x080: COP1LCH (value); break;
-     case 0x082: COP1LCL (value); break;
-     case 0x084: COP2LCH (value); break;
-     case 0x086: COP2LCL (value); break;
-
-     case 0x088: COPJMP1 (value); break;
-     case 0x08A: COPJMP2 (value); break;
-
-     case 0x08E: DIWSTRT (hpos, value); break;
-     case 0x090: DIWSTOP (hpos, value); break;
-     case 0x092: DDFSTRT (hpos, value); break;
-     case 0x094: DDFSTOP (hpos, value); break;
-
-     case 0x096: DMACON (value); break;
-     case 0x098: CLXCON (value); break;
-     case 0x09A: INTENA (value); break;
-     case 0x09C: INTREQ (value); break;
-     case 0x09E: ADKCON (value); break;
-
-     case 0x0A0: AUDxLCH (0, value); break;
-     case 0x0A2: AUDxLCL (0, value); break;
-     case 0x0A4: AUDxLEN (0, value); break;
-     case 0x0A6: AUDxPER (0, value); break;
-     case 0x0A8: AUDxVOL (0, value); break;
-     case 0x0AA: AUDxDAT (0, value); break;
-
-     case 0x0B0: AUDxLCH (1, value); break;
-     case 0x0B2: AUDxLCL (1, value); break;
-     case 0x0B4: AUDxLEN (1, value); break;
-     case 0x0B6: AUDxPER (1, value); break;
-     case 0x0B8: AUDxVOL (1, value); break;
-     case 0x0BA: AUDxDAT (1, value); break;
-
-     case 0x0C0: AUDxLCH (2, value); break;
-     case 0x0C2: AUDxLCL (2, value); break;
-     case 0x0C4: AUDxLEN (2, value); break;
-     case 0x0C6: AUDxPER (2, value); break;
-     case 0x0C8: AUDxVOL (2, value); break;
-     case 0x0CA: AUDxDAT (2, value); break;
-
-     case 0x0D0: AUDxLCH (3, value); break;
-     case 0x0D2: AUDxLCL (3, value); break;
-     case 0x0D4: AUDxLEN (3, value); break;
-     case 0x0D6: AUDxPER (3, value); break;
-     case 0x0D8: AUDxVOL (3, value); break;
-     case 0x0DA: AUDxDAT (3, value); break;
-
-     case 0x0E0: BPLPTH (hpos, value, 0); break;
-     case 0x0E2: BPLPTL (hpos, value, 0); break;
-     case 0x0E4: BPLPTH (hpos, value, 1); break;
-     case 0x0E6: BPLPTL (hpos, value, 1); break;
-     case 0x0E8: BPLPTH (hpos, value, 2); break;
-     case 0x0EA: BPLPTL (hpos, value, 2); break;
-     case 0x0EC: BPLPTH (hpos, value, 3); break;
-     case 0x0EE: BPLPTL (hpos, value, 3); break;
-     case 0x0F0: BPLPTH (hpos, value, 4); break;
-     case 0x0F2: BPLPTL (hpos, value, 4); break;
-     case 0x0F4: BPLPTH (hpos, value, 5); break;
-     case 0x0F6: BPLPTL (hpos, value, 5); break;
-     case 0x0F8: BPLPTH (hpos, value, 6); break;
-     case 0x0FA: BPLPTL (hpos, value, 6); break;
-     case 0x0FC: BPLPTH (hpos, value, 7); break;
-     case 0x0FE: BPLPTL (hpos, value, 7); break;
-
-     case 0x100: BPLCON0 (hpos, value); break;
-     case 0x102: BPLCON1 (hpos, value); break;
-     case 0x104: BPLCON2 (hpos, value); break;
-     case 0x106: BPLCON3 (hpos, value); break;
-
-     case 0x108: BPL1MOD (hpos, value); break;
-     case 0x10A: BPL2MOD (hpos, value); break;
-
-     case 0x110: BPL1DAT (value); break;
-     case 0x112: BPL2DAT (value); break;
-     case 0x114: BPL3DAT (value); break;
-     case 0x116: BPL4DAT (value); break;
-     case 0x118: BPL5DAT (value); break;
-     case 0x11A: BPL6DAT (value); break;
-     case 0x11C: BPL7DAT (value); break;
-     case 0x11E: BPL8DAT (value); break;
-
-     case 0x180: case 0x182: case 0x184: case 0x186: case 0x188: case 0x18A:
-     case 0x18C: case 0x18E: case 0x190: case 0x192: case 0x194: case 0x196:
-     case 0x198: case 0x19A: case 0x19C: case 0x19E: case 0x1A0: case 0x1A2:
-     case 0x1A4: case 0x1A6: case 0x1A8: case 0x1AA: case 0x1AC: case 0x1AE:
-     case 0x1B0: case 0x1B2: case 0x1B4: case 0x1B6: case 0x1B8: case 0x1BA:
-     case 0x1BC: case 0x1BE:
-	COLOR (hpos, value & 0xFFF, (addr & 0x3E) / 2);
-	break;
-     case 0x120: case 0x124: case 0x128: case 0x12C:
-     case 0x130: case 0x134: case 0x138: case 0x13C:
-	SPRxPTH (hpos, value, (addr - 0x120) / 4);
-	break;
-     case 0x122: case 0x126: case 0x12A: case 0x12E:
-     case 0x132: case 0x136: case 0x13A: case 0x13E:
-	SPRxPTL (hpos, value, (addr - 0x122) / 4);
-	break;
-     case 0x140: case 0x148: case 0x150: case 0x158:
-     case 0x160: case 0x168: case 0x170: case 0x178:
-	SPRxPOS (hpos, value, (addr - 0x140) / 8);
-	break;
-     case 0x142: case 0x14A: case 0x152: case 0x15A:
-     case 0x162: case 0x16A: case 0x172: case 0x17A:
-	SPRxCTL (hpos, value, (addr - 0x142) / 8);
-	break;
-     case 0x144: case 0x14C: case 0x154: case 0x15C:
-     case 0x164: case 0x16C: case 0x174: case 0x17C:
-	SPRxDATA (hpos, value, (addr - 0x144) / 8);
-	break;
-     case 0x146: case 0x14E: case 0x156: case 0x15E:
-     case 0x166: case 0x16E: case 0x176: case 0x17E:
-	SPRxDATB (hpos, value, (addr - 0x146) / 8);
-	break;
+    int i;
+
+    for (i = 0; i < 256; i++)
+	set_custom_wput (i << 1, cw_none, 0);
+
+    set_custom_wput (0x020, cw_DSKPTH, 0);
+    set_custom_wput (0x022, cw_DSKPTL, 0);
+    set_custom_wput (0x024, cw_DSKLEN, 0);
+    set_custom_wput (0x026, cw_DSKDAT, 0);
 
-     case 0x36: JOYTEST (value); break;
-     case 0x5A: BLTCON0L (value); break;
-     case 0x5C: BLTSIZV (value); break;
-     case 0x5E: BLTSIZH (value); break;
-     case 0x1E4: DIWHIGH (hpos, value); break;
-     case 0x10C: BPLCON4 (hpos, value); break;
-     case 0x1FC: FMODE (value); break;
+    set_custom_wput (0x02A, cw_VPOSW, 0);
+    set_custom_wput (0x02E, cw_COPCON, 0);
+    set_custom_wput (0x034, cw_POTGO, 0);
+    set_custom_wput (0x040, cw_BLTCON0, 0);
+    set_custom_wput (0x042, cw_BLTCON1, 0);
 
-       /* shd's beamcon 0 patch */
-    case 0x1DC: BEAMCON0 (value); break;
+    set_custom_wput (0x044, cw_BLTAFWM, 0);
+    set_custom_wput (0x046, cw_BLTALWM, 0);
 
+    set_custom_wput (0x050, cw_BLTAPTH, 0);
+    set_custom_wput (0x052, cw_BLTAPTL, 0);
+    set_custom_wput (0x04C, cw_BLTBPTH, 0);
+    set_custom_wput (0x04E, cw_BLTBPTL, 0);
+    set_custom_wput (0x048, cw_BLTCPTH, 0);
+    set_custom_wput (0x04A, cw_BLTCPTL, 0);
+    set_custom_wput (0x054, cw_BLTDPTH, 0);
+    set_custom_wput (0x056, cw_BLTDPTL, 0);
+
+    set_custom_wput (0x058, cw_BLTSIZE, 0);
+
+    set_custom_wput (0x064, cw_BLTAMOD, 0);
+    set_custom_wput (0x062, cw_BLTBMOD, 0);
+    set_custom_wput (0x060, cw_BLTCMOD, 0);
+    set_custom_wput (0x066, cw_BLTDMOD, 0);
+
+    set_custom_wput (0x070, cw_BLTCDAT, 0);
+    set_custom_wput (0x072, cw_BLTBDAT, 0);
+    set_custom_wput (0x074, cw_BLTADAT, 0);
+
+    set_custom_wput (0x07E, cw_DSKSYNC, 0);
+
+    set_custom_wput (0x080, cw_COP1LCH, 0);
+    set_custom_wput (0x082, cw_COP1LCL, 0);
+    set_custom_wput (0x084, cw_COP2LCH, 0);
+    set_custom_wput (0x086, cw_COP2LCL, 0);
+
+    set_custom_wput (0x088, cw_COPJMP1, 0);
+    set_custom_wput (0x08A, cw_COPJMP2, 0);
+
+    set_custom_wput (0x08E, cw_DIWSTRT, 0);
+    set_custom_wput (0x090, cw_DIWSTOP, 0);
+    set_custom_wput (0x092, cw_DDFSTRT, 0);
+    set_custom_wput (0x094, cw_DDFSTOP, 0);
+
+    set_custom_wput (0x096, cw_DMACON, 0);
+    set_custom_wput (0x098, cw_CLXCON, 0);
+    set_custom_wput (0x09A, cw_INTENA, 0);
+    set_custom_wput (0x09C, cw_INTREQ, 0);
+    set_custom_wput (0x09E, cw_ADKCON, 0);
+
+    for (i = 0; i < 4; i++) {
+	set_custom_wput (0x0A0 + 16 * i, cw_AUDxLCH, i);
+	set_custom_wput (0x0A2 + 16 * i, cw_AUDxLCL, i);
+	set_custom_wput (0x0A4 + 16 * i, cw_AUDxLEN, i);
+	set_custom_wput (0x0A6 + 16 * i, cw_AUDxPER, i);
+	set_custom_wput (0x0A8 + 16 * i, cw_AUDxVOL, i);
+	set_custom_wput (0x0AA + 16 * i, cw_AUDxDAT, i);
     }
+
+    for (i = 0; i < 8; i++) {
+	set_custom_wput (0x0E0 + 4 * i, cw_BPLPTH, i);
+	set_custom_wput (0x0E2 + 4 * i, cw_BPLPTL, i);
+    }
+
+    set_custom_wput (0x100, cw_BPLCON0, 0);
+    set_custom_wput (0x102, cw_BPLCON1, 0);
+    set_custom_wput (0x104, cw_BPLCON2, 0);
+    set_custom_wput (0x106, cw_BPLCON3, 0);
+
+    set_custom_wput (0x108, cw_BPL1MOD, 0);
+    set_custom_wput (0x10A, cw_BPL2MOD, 0);
+
+    set_custom_wput (0x110, cw_BPL1DAT, 0);
+    set_custom_wput (0x112, cw_BPL2DAT, 0);
+    set_custom_wput (0x114, cw_BPL3DAT, 0);
+    set_custom_wput (0x116, cw_BPL4DAT, 0);
+    set_custom_wput (0x118, cw_BPL5DAT, 0);
+    set_custom_wput (0x11A, cw_BPL6DAT, 0);
+    set_custom_wput (0x11C, cw_BPL7DAT, 0);
+    set_custom_wput (0x11E, cw_BPL8DAT, 0);
+
+    for (i = 0; i < 32; i++)
+	set_custom_wput (0x180 + 2 * i, cw_COLOR, i);
+
+    for (i = 0; i < 8; i++) {
+	set_custom_wput (0x120 + 4 * i, cw_SPRxPTH, i);
+	set_custom_wput (0x122 + 4 * i, cw_SPRxPTL, i);
+	set_custom_wput (0x140 + 8 * i, cw_SPRxPOS, i);
+	set_custom_wput (0x142 + 8 * i, cw_SPRxCTL, i);
+	set_custom_wput (0x144 + 8 * i, cw_SPRxDATA, i);
+	set_custom_wput (0x146 + 8 * i, cw_SPRxDATB, i);
+    }
+
+    set_custom_wput (0x036, cw_JOYTEST, 0);
+    set_custom_wput (0x05A, cw_BLTCON0L, 0);
+    set_custom_wput (0x05C, cw_BLTSIZV, 0);
+    set_custom_wput (0x05E, cw_BLTSIZH, 0);
+    set_custom_wput (0x1E4, cw_DIWHIGH, 0);
+    set_custom_wput (0x10C, cw_BPLCON4, 0);
+    set_custom_wput (0x1FC, cw_FMODE, 0);
+
+    /* shd's beamcon 0 patch */
+    set_custom_wput (0x1DC, cw_BEAMCON0, 0);
+}
+
+static void REGPARAM2 custom_wput_1 (int hpos, uaecptr addr, uae_u32 value)
+{
+    struct custom_wput_handler *h = &custom_wput_tbl[(addr & 0x1FE) >> 1];
+
+    h->func (hpos, h->num, value);
 }
 
 static void REGPARAM2 custom_wput (uaecptr addr, uae_u32 value)
@@ -385,6 +385,7 @@ static void set_break(uae_u32 addr) {
 static void history_log(void) {
 #ifdef NEED_TO_DEBUG_BADLY
   history[lasthist] = regs;
+  FLUSH_FLAGS;
   historyf[lasthist] = regflags;
 #else
   history[lasthist] = m68k_getpc();
@@ -51,6 +51,7 @@ static const struct epconfattr boolean_options[] = {
 	{.s = "ntsc",               .e = ES_NTSC,                .o = UC_NTSC},
 	{.s = "one_subsong",        .e = ES_ONE_SUBSONG,         .o = UC_ONE_SUBSONG},
 	{.s = "pal",                .e = ES_PAL,                 .o = UC_PAL},
+	{.s = "period_clamp",       .e = ES_PERIOD_CLAMP,        .o = UC_PERIOD_CLAMP},
 	{.s = "reject",             .e = ES_REJECT,              .o = 0},
 	{.s = "speed_hack",         .e = ES_SPEED_HACK,          .o = UC_SPEED_HACK},
 	{.s = NULL}
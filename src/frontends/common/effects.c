@@ -33,10 +33,17 @@
 
 #define DENORMAL_OFFSET 1E-10
 
-static void gain(int gain_amount, int16_t * sm, int frames);
-static void pan(int pan_amount, int16_t * sm, int frames);
-static void headphones(int16_t * sm, int frames, struct uade_effect_state *es);
-static void headphones2(int16_t * sm, int frames, struct uade_effect_state *es);
+/* int32 samples are converted to float in blocks of this many frames */
+#define EFFECT_BLOCK_FRAMES 256
+
+static void gain(float gain_amount, float *sm, int frames);
+static void pan(float pan_amount, float *sm, int frames);
+static void headphones(float *sm, int frames, struct uade_effect_state *es);
+static void headphones2(float *sm, int frames, struct uade_effect_state *es);
+static void gain_s16(int gain_amount, int16_t *sm, int frames);
+static void pan_s16(int pan_amount, int16_t *sm, int frames);
+static void headphones_s16(int16_t *sm, int frames, struct uade_effect_state *es);
+static void headphones2_s16(int16_t *sm, int frames, struct uade_effect_state *es);
 
 static void consistencycheck(void)
 {
@@ -61,6 +68,19 @@ static inline int sampleclip(int x)
 	return x;
 }
 
+/* Round a float sample to int32 with clipping */
+static inline int32_t sampleclip32(float x)
+{
+	double y = x * 2147483648.0;
+	if (unlikely(y >= 2147483647.0 || y <= -2147483648.0)) {
+		if (y > 0)
+			return INT32_MAX;
+		else
+			return INT32_MIN;
+	}
+	return (int32_t) (y + (y >= 0 ? 0.5 : -0.5));
+}
+
 /* calculate a high shelve filter */
 static void calculate_shelve(double fs, double fc, double g, uade_biquad_t * bq)
 {
@@ -151,18 +171,78 @@ int uade_effect_is_enabled(const struct uade_state *state, uade_effect_t effect)
 	return (es->enabled & (1 << effect)) != 0;
 }
 
-void uade_effect_run(struct uade_state *state, int16_t *samples, int frames)
+static void run_effects(struct uade_effect_state *es, float *samples,
+			int frames)
+{
+	if (es->enabled & (1 << UADE_EFFECT_PAN))
+		pan(es->pan, samples, frames);
+	if (es->enabled & (1 << UADE_EFFECT_HEADPHONES))
+		headphones(samples, frames, es);
+	if (es->enabled & (1 << UADE_EFFECT_HEADPHONES2) && es->rate)
+		headphones2(samples, frames, es);
+	if (es->enabled & (1 << UADE_EFFECT_GAIN))
+		gain(es->gain, samples, frames);
+}
+
+/*
+ * int16 samples go through the integer effects. Their output is the same
+ * as it was before the other sample formats were added: gain and pan are
+ * quantised to 1/256, and each effect clips.
+ */
+static void run_effects_s16(struct uade_effect_state *es, int16_t *samples,
+			    int frames)
+{
+	if (es->enabled & (1 << UADE_EFFECT_PAN))
+		pan_s16(es->pan * 256.0, samples, frames);
+	if (es->enabled & (1 << UADE_EFFECT_HEADPHONES))
+		headphones_s16(samples, frames, es);
+	if (es->enabled & (1 << UADE_EFFECT_HEADPHONES2) && es->rate)
+		headphones2_s16(samples, frames, es);
+	if (es->enabled & (1 << UADE_EFFECT_GAIN))
+		gain_s16(es->gain * 256.0, samples, frames);
+}
+
+/*
+ * int32 and float samples are computed in float with full scale [-1, 1].
+ * Float samples are processed in place. int32 samples are converted to
+ * float and back, and they are clipped only once, after all the effects.
+ */
+void uade_effect_run(struct uade_state *state, void *samples, int frames)
 {
 	struct uade_effect_state *es = &state->effectstate;
-	if (es->enabled & (1 << UADE_EFFECT_ALLOW)) {
-		if (es->enabled & (1 << UADE_EFFECT_PAN))
-			pan(es->pan, samples, frames);
-		if (es->enabled & (1 << UADE_EFFECT_HEADPHONES))
-			headphones(samples, frames, es);
-		if (es->enabled & (1 << UADE_EFFECT_HEADPHONES2) && es->rate)
-			headphones2(samples, frames, es);
-		if (es->enabled & (1 << UADE_EFFECT_GAIN))
-			gain(es->gain, samples, frames);
+	enum uade_sample_format format = state->config.sample_format;
+	float block[UADE_CHANNELS * EFFECT_BLOCK_FRAMES];
+	int32_t *sm;
+	int i, n;
+
+	if (!(es->enabled & (1 << UADE_EFFECT_ALLOW)))
+		return;
+	/* Don't convert samples if no effect is enabled */
+	if (!(es->enabled & ~(1 << UADE_EFFECT_ALLOW)))
+		return;
+
+	if (format == UADE_SAMPLE_S16) {
+		run_effects_s16(es, samples, frames);
+		return;
+	}
+
+	if (format == UADE_SAMPLE_FLOAT) {
+		run_effects(es, samples, frames);
+		return;
+	}
+
+	sm = samples;
+	while (frames > 0) {
+		n = frames < EFFECT_BLOCK_FRAMES ? frames : EFFECT_BLOCK_FRAMES;
+
+		for (i = 0; i < UADE_CHANNELS * n; i++)
+			block[i] = sm[i] * (1.0 / 2147483648.0);
+		run_effects(es, block, n);
+		for (i = 0; i < UADE_CHANNELS * n; i++)
+			sm[i] = sampleclip32(block[i]);
+
+		sm += UADE_CHANNELS * n;
+		frames -= n;
 	}
 }
 
@@ -213,25 +293,46 @@ void uade_effect_gain_set_amount(struct uade_state *state, float amount)
 {
 	struct uade_effect_state *es = &state->effectstate;
 	assert(amount >= 0.0 && amount <= 128.0);
-	es->gain = amount * 256.0;
+	es->gain = amount;
 }
 
 void uade_effect_pan_set_amount(struct uade_state *state, float amount)
 {
 	struct uade_effect_state *es = &state->effectstate;
 	assert(amount >= 0.0 && amount <= 2.0);
-	es->pan = amount * 256.0 / 2.0;
+	es->pan = amount / 2.0;
 }
 
-static void gain(int gain_amount, int16_t *sm, int frames)
+static void gain(float gain_amount, float *sm, int frames)
 {
 	int i;
 	for (i = 0; i < 2 * frames; i += 1)
-		sm[i] = sampleclip((sm[i] * gain_amount) >> 8);
+		sm[i] *= gain_amount;
 }
 
 /* Panning effect. Turns stereo into mono in a specific degree */
-static void pan(int pan_amount, int16_t *sm, int frames)
+static void pan(float pan_amount, float *sm, int frames)
+{
+	int i;
+	float l, r, m;
+	for (i = 0; i < frames; i += 1) {
+		l = sm[0];
+		r = sm[1];
+		m = (r - l) * pan_amount;
+		sm[0] = l + m;
+		sm[1] = r - m;
+		sm += 2;
+	}
+}
+
+static void gain_s16(int gain_amount, int16_t *sm, int frames)
+{
+	int i;
+	for (i = 0; i < 2 * frames; i += 1)
+		sm[i] = sampleclip((sm[i] * gain_amount) >> 8);
+}
+
+static void pan_s16(int pan_amount, int16_t *sm, int frames)
 {
 	int i, l, r, m;
 	for (i = 0; i < frames; i += 1) {
@@ -273,26 +374,44 @@ static float headphones_lpf(float in, float *state)
 }
 
 /* A real implementation would simply perform FIR with recorded HRTF data. */
-static void headphones(int16_t *sm, int frames, struct uade_effect_state *es)
+static inline void headphones_frame(float l, float r, double *l_final,
+				    double *r_final,
+				    struct uade_effect_state *es)
 {
-	int i;
 	float ld, rd;
-	int l_final;
-	int r_final;
+
+	ld = headphones_allpass_delay(l, es->headphones_ap_l);
+	rd = headphones_allpass_delay(r, es->headphones_ap_r);
+	ld = headphones_lpf(ld, es->headphones_rc_l);
+	rd = headphones_lpf(rd, es->headphones_rc_r);
+
+	*l_final = (l + rd * UADE_EFFECT_HEADPHONES_CROSSMIX_VOL) / 2;
+	*r_final = (r + ld * UADE_EFFECT_HEADPHONES_CROSSMIX_VOL) / 2;
+}
+
+static void headphones(float *sm, int frames, struct uade_effect_state *es)
+{
+	int i;
+	double l_final, r_final;
 
 	for (i = 0; i < frames; i += 1) {
-		ld = headphones_allpass_delay(sm[0], es->headphones_ap_l);
-		rd = headphones_allpass_delay(sm[1], es->headphones_ap_r);
-		ld = headphones_lpf(ld, es->headphones_rc_l);
-		rd = headphones_lpf(rd, es->headphones_rc_r);
-
-		l_final =
-		    (sm[0] + rd * UADE_EFFECT_HEADPHONES_CROSSMIX_VOL) / 2;
-		r_final =
-		    (sm[1] + ld * UADE_EFFECT_HEADPHONES_CROSSMIX_VOL) / 2;
+		headphones_frame(sm[0], sm[1], &l_final, &r_final, es);
+		sm[0] = l_final;
+		sm[1] = r_final;
+		sm += 2;
+	}
+}
+
+static void headphones_s16(int16_t *sm, int frames,
+			   struct uade_effect_state *es)
+{
+	int i;
+	double l_final, r_final;
+
+	for (i = 0; i < frames; i += 1) {
+		headphones_frame(sm[0], sm[1], &l_final, &r_final, es);
 		sm[0] = sampleclip(l_final);
 		sm[1] = sampleclip(r_final);
-
 		sm += 2;
 	}
 }
@@ -314,22 +433,43 @@ static float headphone2_allpass_delay(float in, float *state,
 	return output;
 }
 
-static void headphones2(int16_t *sm, int frames, struct uade_effect_state *es)
+static inline void headphones2_frame(float l, float r, float *l_final,
+				     float *r_final,
+				     struct uade_effect_state *es)
+{
+	float ld, rd;
+
+	ld = headphone2_allpass_delay(l, es->headphone2_ap_l, es);
+	rd = headphone2_allpass_delay(r, es->headphone2_ap_r, es);
+	ld = evaluate_biquad(ld, &es->headphone2_rc_l);
+	rd = evaluate_biquad(rd, &es->headphone2_rc_r);
+	ld = evaluate_biquad(ld, &es->headphone2_shelve_l);
+	rd = evaluate_biquad(rd, &es->headphone2_shelve_r);
+
+	*l_final = (l + rd) / 2;
+	*r_final = (r + ld) / 2;
+}
+
+static void headphones2(float *sm, int frames, struct uade_effect_state *es)
 {
 	int i;
 
 	for (i = 0; i < frames; i += 1) {
-		float ld, rd;
+		headphones2_frame(sm[0], sm[1], &sm[0], &sm[1], es);
+		sm += 2;
+	}
+}
 
-		ld = headphone2_allpass_delay(sm[0], es->headphone2_ap_l, es);
-		rd = headphone2_allpass_delay(sm[1], es->headphone2_ap_r, es);
-		ld = evaluate_biquad(ld, &es->headphone2_rc_l);
-		rd = evaluate_biquad(rd, &es->headphone2_rc_r);
-		ld = evaluate_biquad(ld, &es->headphone2_shelve_l);
-		rd = evaluate_biquad(rd, &es->headphone2_shelve_r);
+static void headphones2_s16(int16_t *sm, int frames,
+			    struct uade_effect_state *es)
+{
+	int i;
+	float l_final, r_final;
 
-		sm[0] = sampleclip((sm[0] + rd) / 2);
-		sm[1] = sampleclip((sm[1] + ld) / 2);
+	for (i = 0; i < frames; i += 1) {
+		headphones2_frame(sm[0], sm[1], &l_final, &r_final, es);
+		sm[0] = sampleclip(l_final);
+		sm[1] = sampleclip(r_final);
 		sm += 2;
 	}
 }
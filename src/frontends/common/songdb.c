@@ -518,35 +518,55 @@ void uade_save_content_db(const char *filename, struct uade_state *state)
 	uade_debug(state, "uade: Saved %zd entries into content db.\n", db->nccused);
 }
 
+/*
+ * Returns the number of samples whose amplitude is at least 1 % of full scale.
+ * Counting stops at 'limit'.
+ */
+static int count_loud_samples(const void *buf, int nsamples, int limit,
+			      enum uade_sample_format format)
+{
+	const int s16limit = 32767 * 1 / 100;
+	int i, n = 0;
+
+	if (format == UADE_SAMPLE_S16) {
+		const int16_t *sm = buf;
+		for (i = 0; i < nsamples && n < limit; i++)
+			n += (sm[i] >= s16limit || sm[i] <= -s16limit);
+	} else if (format == UADE_SAMPLE_S32) {
+		const int32_t *sm = buf;
+		const int32_t s32limit = s16limit * 65536;
+		for (i = 0; i < nsamples && n < limit; i++)
+			n += (sm[i] >= s32limit || sm[i] <= -s32limit);
+	} else {
+		const float *sm = buf;
+		const float flimit = s16limit / 32768.0f;
+		for (i = 0; i < nsamples && n < limit; i++)
+			n += (sm[i] >= flimit || sm[i] <= -flimit);
+	}
+	return n;
+}
+
 int uade_test_silence(void *buf, size_t size, struct uade_state *state)
 {
-	int i, s, exceptioncount;
-	int16_t *sm;
-	int nsamples;
+	int bytesperframe = uade_get_bytes_per_frame(state);
+	int nsamples = size / (bytesperframe / uade_get_channels(state));
+	/* The song is not silent if 4 % of the samples are loud */
+	int limit = nsamples * 4 / 100;
 	int64_t count = state->song.silencecount;
 	int end = 0;
 
 	if (state->config.silence_timeout < 0)
 		return 0;
 
-	exceptioncount = 0;
-	sm = buf;
-	nsamples = size / 2;
+	if (limit < 1)
+		limit = 1;
 
-	for (i = 0; i < nsamples; i++) {
-		s = (sm[i] >= 0) ? sm[i] : -sm[i];
-		if (s >= (32767 * 1 / 100)) {
-			exceptioncount++;
-			if (exceptioncount >= (size * 2 / 100)) {
-				count = 0;
-				break;
-			}
-		}
-	}
-
-	if (i == nsamples) {
+	if (count_loud_samples(buf, nsamples, limit,
+			       state->config.sample_format) >= limit) {
+		count = 0;
+	} else {
 		count += size;
-		if (count / (UADE_BYTES_PER_FRAME * state->config.frequency) >= state->config.silence_timeout) {
+		if (count / (bytesperframe * state->config.frequency) >= state->config.silence_timeout) {
 			count = 0;
 			end = 1;
 		}
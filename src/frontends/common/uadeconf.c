@@ -45,6 +45,7 @@ struct uade_conf_opts {
    string match length for the option name and its enum code. */
 static const struct uade_conf_opts uadeconfopts[] = {
 	{.str = "ao_option",             .l = 2,  .e = UC_AO_OPTION},
+	{.str = "cpu_profile_file",      .l = 3,  .e = UC_CPU_PROFILE_FILE},
 	{.str = "detect_format_by_detection", .l = 18, .e = UC_CONTENT_DETECTION},
 	{.str = "disable_timeout",       .l = 1,  .e = UC_DISABLE_TIMEOUTS},
 	{.str = "enable_timeout",        .l = 2,  .e = UC_ENABLE_TIMEOUTS},
@@ -68,6 +69,8 @@ static const struct uade_conf_opts uadeconfopts[] = {
 	{.str = "one_subsong",           .l = 1,  .e = UC_ONE_SUBSONG},
 	{.str = "pal",                   .l = 3,  .e = UC_PAL},
 	{.str = "panning_value",         .l = 3,  .e = UC_PANNING_VALUE},
+	{.str = "period_clamp",          .l = 2,  .e = UC_PERIOD_CLAMP},
+	{.str = "read_credits",          .l = 3,  .e = UC_READ_CREDITS},
 	{.str = "resampler",             .l = 1,  .e = UC_RESAMPLER},
 	{.str = "silence_timeout_value", .l = 2,  .e = UC_SILENCE_TIMEOUT_VALUE},
 	{.str = "speed_hack",            .l = 2,  .e = UC_SPEED_HACK},
@@ -130,6 +133,7 @@ void uade_config_set_defaults(struct uade_config *uc)
 	uc->frequency = UADE_DEFAULT_FREQUENCY;
 	uc->gain = 1.0;
 	uc->panning = 0.7;
+	uc->read_credits = 4;
 	uc->silence_timeout = 20;
 	uc->subsong_timeout = 512;
 	uc->timeout = -1;
@@ -396,6 +400,7 @@ void uade_merge_configs(struct uade_config *ucd, const struct uade_config *ucs)
 	MERGE_OPTION(ao_options);
 	MERGE_OPTION(basedir);
 	MERGE_OPTION(content_detection);
+	MERGE_OPTION(cpu_profile_file);
 	MERGE_OPTION(ep_options);
 	MERGE_OPTION(filter_type);
 	MERGE_OPTION(frequency);
@@ -413,9 +418,13 @@ void uade_merge_configs(struct uade_config *ucd, const struct uade_config *ucs)
 	MERGE_OPTION(one_subsong);
 	MERGE_OPTION(panning);
 	MERGE_OPTION(panning_enable);
+	MERGE_OPTION(period_clamp);
 	MERGE_OPTION(player_file);
+	MERGE_OPTION(read_credits);
 	MERGE_OPTION(resampler);
+	MERGE_OPTION(sample_format);
 	MERGE_OPTION(score_file);
+	MERGE_OPTION(separate_voices);
 	MERGE_OPTION(silence_timeout);
 	MERGE_OPTION(speed_hack);
 	MERGE_OPTION(subsong_timeout);
@@ -555,6 +564,10 @@ void uade_config_set_option(struct uade_config *uc, enum uade_option opt,
 		SET_OPTION(content_detection, 1);
 		break;
 
+	case UC_CPU_PROFILE_FILE:
+		handle_config_path(&uc->cpu_profile_file, &uc->cpu_profile_file_set, value);
+		break;
+
 	case UC_DISABLE_TIMEOUTS:
 		SET_OPTION(use_timeouts, 0);
 		break;
@@ -712,14 +725,51 @@ void uade_config_set_option(struct uade_config *uc, enum uade_option opt,
 		SET_OPTION(panning, uade_convert_to_double(value, 0.0, 0.0, 2.0, "panning"));
 		break;
 
+	case UC_PERIOD_CLAMP:
+		SET_OPTION(period_clamp, 1);
+		break;
+
 	case UC_PLAYER_FILE:
 		handle_config_path(&uc->player_file, &uc->player_file_set, value);
 		break;
 
+	case UC_READ_CREDITS:
+		if (value == NULL) {
+			fprintf(stderr, "uade: UC_READ_CREDITS value is NULL\n");
+			break;
+		}
+		x = strtol(value, &endptr, 10);
+		if (*endptr != 0 || x < 1 || x > UADE_MAX_READ_CREDITS) {
+			fprintf(stderr, "Invalid read credits: %s\n", value);
+			break;
+		}
+		SET_OPTION(read_credits, x);
+		break;
+
+	case UC_SAMPLE_FORMAT:
+		if (value == NULL) {
+			fprintf(stderr, "uade: UC_SAMPLE_FORMAT value is NULL\n");
+			break;
+		}
+		if (strcasecmp(value, "s16") == 0) {
+			SET_OPTION(sample_format, UADE_SAMPLE_S16);
+		} else if (strcasecmp(value, "s32") == 0) {
+			SET_OPTION(sample_format, UADE_SAMPLE_S32);
+		} else if (strcasecmp(value, "float") == 0) {
+			SET_OPTION(sample_format, UADE_SAMPLE_FLOAT);
+		} else {
+			fprintf(stderr, "Unknown sample format: %s\n", value);
+		}
+		break;
+
 	case UC_SCORE_FILE:
 		handle_config_path(&uc->score_file, &uc->score_file_set, value);
 		break;
 
+	case UC_SEPARATE_VOICES:
+		SET_OPTION(separate_voices, 1);
+		break;
+
 	case UC_SILENCE_TIMEOUT_VALUE:
 		if (value == NULL) {
 			fprintf(stderr,
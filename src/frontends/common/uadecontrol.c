@@ -23,11 +23,15 @@
 #include <unistd.h>
 #include <sys/socket.h>
 
-/* Sends a byte request and returns the number of bytes requested */
+/*
+ * Sends a byte request and returns the number of bytes requested. Each
+ * read credit is one data block that uadecore may render before libuade
+ * gets the token back.
+ */
 int uade_read_request(struct uade_state *state)
 {
 	struct uade_ipc *ipc = &state->ipc;
-	uint32_t left = UADE_MAX_MESSAGE_SIZE - sizeof(struct uade_msg);
+	uint32_t left = state->config.read_credits * UADE_READ_BLOCK_SIZE;
 	return uade_send_u32(UADE_COMMAND_READ, left, ipc) ? 0 : left;
 }
 
@@ -176,6 +180,13 @@ int uade_song_initialization(struct uade_file *player, struct uade_file *module,
 		}
 	}
 
+	if (uc->period_clamp) {
+		if (uade_send_short_message(UADE_COMMAND_PERIOD_CLAMP, ipc)) {
+			fprintf(stderr, "Can not send period clamp command.\n");
+			goto cleanup;
+		}
+	}
+
 	if (uc->use_ntsc) {
 		if (uade_send_short_message(UADE_COMMAND_SET_NTSC, ipc)) {
 			fprintf(stderr, "Can not send ntsc command.\n");
@@ -191,6 +202,27 @@ int uade_song_initialization(struct uade_file *player, struct uade_file *module,
 		}
 	}
 
+	if (uc->sample_format != UADE_SAMPLE_S16) {
+		if (uade_send_u32(UADE_COMMAND_SET_SAMPLE_FORMAT,
+				  uc->sample_format, ipc)) {
+			fprintf(stderr, "Can not send sample format.\n");
+			goto cleanup;
+		}
+	}
+
+	/* uadecore runs on the same host, so skip the big endian swaps */
+	if (uade_send_u32(UADE_COMMAND_SAMPLE_BYTE_ORDER, 1, ipc)) {
+		fprintf(stderr, "Can not send sample byte order.\n");
+		goto cleanup;
+	}
+
+	if (uc->separate_voices) {
+		if (uade_send_short_message(UADE_COMMAND_SEPARATE_VOICES, ipc)) {
+			fprintf(stderr, "Can not send separate voices command.\n");
+			goto cleanup;
+		}
+	}
+
 	if (uc->use_text_scope) {
 		if (uade_send_short_message(UADE_COMMAND_USE_TEXT_SCOPE, ipc)) {
 			fprintf(stderr,	"Can not send use text scope command.\n");
@@ -198,6 +230,13 @@ int uade_song_initialization(struct uade_file *player, struct uade_file *module,
 		}
 	}
 
+	if (uc->cpu_profile_file.name[0]) {
+		if (uade_send_short_message(UADE_COMMAND_CPU_PROFILE, ipc)) {
+			fprintf(stderr, "Can not send cpu profile command.\n");
+			goto cleanup;
+		}
+	}
+
 	if (send_ep_options(&us->ep_options, ipc) ||
 	    send_ep_options(&uc->ep_options, ipc))
 		goto cleanup;
@@ -344,6 +344,40 @@ int uade_send_message(struct uade_msg *um, struct uade_ipc *ipc)
 	return 0;
 }
 
+/*
+ * Like uade_send_message(), but the payload is in a separate buffer. The
+ * header and the payload go out with one writev(), so the payload does not
+ * need to be copied behind a header first.
+ */
+int uade_send_message_data(enum uade_msgtype com, const void *data,
+			   uint32_t size, struct uade_ipc *ipc)
+{
+	struct uade_msg um = {.msgtype = com, .size = size};
+	struct iovec iov[2];
+
+	if (ipc->state == UADE_INITIAL_STATE) {
+		ipc->state = UADE_S_STATE;
+	} else if (ipc->state == UADE_R_STATE) {
+		fprintf(stderr, "protocol error: sending in R state is forbidden\n");
+		return -1;
+	}
+	if (!valid_message(&um)) {
+		fprintf(stderr, "uadeipc: Tried to send an invalid message\n");
+		return -1;
+	}
+	if (com == UADE_COMMAND_TOKEN)
+		ipc->state = UADE_R_STATE;
+	um.msgtype = htonl(um.msgtype);
+	um.size = htonl(um.size);
+	iov[0] = (struct iovec) {.iov_base = &um, .iov_len = sizeof um};
+	iov[1] = (struct iovec) {.iov_base = (void *) data, .iov_len = size};
+	if (uade_atomic_writev(ipc->out_fd, iov, 2) < 0) {
+		fprintf(stderr, "uade_atomic_writev() failed\n");
+		return -1;
+	}
+	return 0;
+}
+
 int uade_send_short_message(enum uade_msgtype msgtype, struct uade_ipc *ipc)
 {
 	struct uade_msg msg = {.msgtype = msgtype};
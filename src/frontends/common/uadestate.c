@@ -93,7 +93,7 @@ static void prepare_configs(struct uade_state *state)
 
 static int get_bytes_per_second(const struct uade_state *state)
 {
-	return UADE_BYTES_PER_FRAME * uade_get_sampling_rate(state);
+	return uade_get_bytes_per_frame(state) * uade_get_sampling_rate(state);
 }
 
 void uade_cleanup_state(struct uade_state *state)
@@ -155,9 +155,7 @@ static int receive_message(struct uade_event *event, struct uade_state *state)
 {
 	uint8_t space[UADE_MAX_MESSAGE_SIZE];
 	struct uade_msg *um = (struct uade_msg *) space;
-	uint16_t *data;
-	uint16_t *sm;
-	unsigned int u;
+	uint32_t ringoffset, ringsize;
 	int i;
 	char *reason;
 	int tailbytes;
@@ -179,22 +177,43 @@ static int receive_message(struct uade_event *event, struct uade_state *state)
 
 	case UADE_REPLY_DATA:
 		event->type = UADE_EVENT_DATA;
-		data = (uint16_t *) event->data.data;
 
-		assert(um->size == state->song.bytesrequested);
-		assert(um->size % 2 == 0);
+		assert(um->size <= state->song.bytesrequested);
+		assert(um->size % uade_get_bytes_per_frame(state) == 0);
+		state->song.bytesrequested -= um->size;
 		assert(sizeof event->data.data >= um->size);
 		event->data.size = um->size;
 
-		sm = (uint16_t *) um->data;
-		for (u = 0; u < um->size; u += 2) {
-			*data = ntohs(*sm);
-			sm++;
-			data++;
-		}
+		/* Samples are in host byte order, see uade_song_initialization() */
+		memcpy(event->data.data, um->data, um->size);
 
 		break;
 
+	case UADE_REPLY_RING_DATA:
+		event->type = UADE_EVENT_DATA;
+
+		if (state->ipc.ring == NULL ||
+		    uade_parse_two_u32s_message(&ringoffset, &ringsize, um)) {
+			uade_warning("Invalid ring data reply\n");
+			goto error;
+		}
+		if (ringoffset >= UADE_RING_SIZE ||
+		    ringoffset % UADE_RING_SLOT_SIZE != 0 ||
+		    ringsize > UADE_RING_SLOT_SIZE) {
+			uade_warning("Ring data out of bounds: %u %u\n",
+				     ringoffset, ringsize);
+			goto error;
+		}
+		assert(ringsize <= state->song.bytesrequested);
+		assert(ringsize % uade_get_bytes_per_frame(state) == 0);
+		state->song.bytesrequested -= ringsize;
+		assert(sizeof event->data.data >= ringsize);
+		event->data.size = ringsize;
+
+		/* Samples in the ring are in host byte order */
+		memcpy(event->data.data, state->ipc.ring + ringoffset, ringsize);
+		break;
+
 	case UADE_REPLY_FORMATNAME:
 		event->type = UADE_EVENT_FORMAT_NAME;
 		get_string(event, um);
@@ -488,7 +507,7 @@ static void set_subsong_and_seek(int whence, int subsong, int64_t seekoffs,
 static int64_t samples_to_offset(ssize_t samples,
 				 const struct uade_state *state)
 {
-	return ((int64_t) samples) * UADE_BYTES_PER_FRAME;
+	return ((int64_t) samples) * uade_get_bytes_per_frame(state);
 }
 
 static int seek_subsong_relative(ssize_t samples, int subsong,
@@ -666,6 +685,24 @@ int uade_get_sampling_rate(const struct uade_state *state)
 	return frequency;
 }
 
+enum uade_sample_format uade_get_sample_format(const struct uade_state *state)
+{
+	return state->config.sample_format;
+}
+
+int uade_get_channels(const struct uade_state *state)
+{
+	return state->config.separate_voices ? UADE_VOICES : UADE_CHANNELS;
+}
+
+int uade_get_bytes_per_frame(const struct uade_state *state)
+{
+	int bytespersample = 4;
+	if (state->config.sample_format == UADE_SAMPLE_S16)
+		bytespersample = UADE_BYTES_PER_SAMPLE;
+	return uade_get_channels(state) * bytespersample;
+}
+
 double uade_get_time_position(enum uade_seek_mode whence,
 			      const struct uade_state *state)
 {
@@ -690,6 +727,49 @@ double uade_get_time_position(enum uade_seek_mode whence,
 	return ((double) bytes) / get_bytes_per_second(state);
 }
 
+/*
+ * Append the instruction profile that uadecore sends at the end of a song
+ * into cpu_profile_file. gencpu --profile reads the pair lines.
+ */
+static void write_cpu_profile(struct uade_msg *um, struct uade_state *state)
+{
+	uint8_t *p = um->data;
+	uint32_t nops, npairs, pair, u;
+	FILE *f;
+
+	if (um->size < 16) {
+		uade_warning("Invalid cpu profile reply: too short\n");
+		return;
+	}
+	nops = read_be_u32(p + 8);
+	npairs = read_be_u32(p + 12);
+	if (nops > 512 || npairs > 512 || um->size != 16 + 8 * (nops + npairs)) {
+		uade_warning("Invalid cpu profile reply: bad size\n");
+		return;
+	}
+
+	f = fopen(state->config.cpu_profile_file.name, "a");
+	if (f == NULL) {
+		uade_warning("Can not open cpu profile file %s: %s\n",
+			     state->config.cpu_profile_file.name,
+			     strerror(errno));
+		return;
+	}
+	fprintf(f, "profile\t%s\t%s\n", state->song.info.playerfname,
+		state->song.info.modulefname);
+	fprintf(f, "total %llu\n",
+		((unsigned long long) read_be_u32(p) << 32) | read_be_u32(p + 4));
+	p += 16;
+	for (u = 0; u < nops; u++, p += 8)
+		fprintf(f, "op %04x %u\n", read_be_u32(p), read_be_u32(p + 4));
+	for (u = 0; u < npairs; u++, p += 8) {
+		pair = read_be_u32(p);
+		fprintf(f, "pair %04x %04x %u\n", pair >> 16, pair & 0xffff,
+			read_be_u32(p + 4));
+	}
+	fclose(f);
+}
+
 static int get_pending_events(struct uade_state *state)
 {
 	uint8_t space[UADE_MAX_MESSAGE_SIZE];
@@ -707,6 +787,8 @@ static int get_pending_events(struct uade_state *state)
 				uade_warning("Can not flush send file\n");
 				return error_state(state);
 			}
+		} else if (um->msgtype == UADE_REPLY_CPU_PROFILE) {
+			write_cpu_profile(um, state);
 		}
 	}
 
@@ -793,8 +875,14 @@ static int handle_data(struct uade_event *event, struct uade_state *state)
 	state->song.info.subsongbytes += event->data.size;
 	state->song.info.songbytes += event->data.size;
 
-	if (!isend && test_timeouts(event, state))
+	if (!isend && test_timeouts(event, state)) {
+		/*
+		 * uadecore keeps rendering the rest of the read request.
+		 * That data belongs to the song that just ended.
+		 */
+		state->song.skipdata = 1;
 		return 0;
+	}
 
 	if (handle_seek(event, state)) {
 		/*
@@ -805,8 +893,11 @@ static int handle_data(struct uade_event *event, struct uade_state *state)
 			return -1;
 	}
 
-	nframes = event->data.size / UADE_BYTES_PER_FRAME;
-	uade_effect_run(state, (int16_t *) event->data.data, nframes);
+	/* Effects are stereo effects, so they don't apply to voices */
+	if (!state->config.separate_voices) {
+		nframes = event->data.size / uade_get_bytes_per_frame(state);
+		uade_effect_run(state, event->data.data, nframes);
+	}
 
 	return 0;
 }
@@ -829,6 +920,8 @@ static int receive_messages(struct uade_event *event, struct uade_state *state)
 
 		switch (event->type) {
 		case UADE_EVENT_SONG_END:
+			if (state->song.skipdata)
+				break;
 			state->song.endevent = *event;
 			set_state(UADE_STATE_SONG_END_PENDING, state);
 			/*
@@ -839,12 +932,13 @@ static int receive_messages(struct uade_event *event, struct uade_state *state)
 			break;
 
 		case UADE_EVENT_DATA:
-			if (handle_data(event, state))
+			if (state->song.skipdata || handle_data(event, state))
 				break;
 			return 0;
 
 		case UADE_EVENT_READY:
 			ASSERT_SEND_STATE(state);
+			state->song.skipdata = 0;
 
 			if (test_set_debug(state))
 				return error_state(state);
@@ -1014,7 +1108,8 @@ int uade_read_notification(struct uade_notification *n,
 	return 1;
 }
 
-ssize_t uade_read(void *_data, size_t bytes, struct uade_state *state)
+static ssize_t read_frames(void *_data, size_t bytes,
+			   struct uade_state *state)
 {
 	uint8_t *data = _data;
 	size_t copied = 0;
@@ -1088,6 +1183,24 @@ ssize_t uade_read(void *_data, size_t bytes, struct uade_state *state)
 	return copied;
 }
 
+ssize_t uade_read(void *data, size_t bytes, struct uade_state *state)
+{
+	if (state->config.separate_voices) {
+		uade_warning("uade_read(): Use uade_read_voices() for separate voices.\n");
+		return -1;
+	}
+	return read_frames(data, bytes, state);
+}
+
+ssize_t uade_read_voices(void *data, size_t bytes, struct uade_state *state)
+{
+	if (!state->config.separate_voices) {
+		uade_warning("uade_read_voices(): UC_SEPARATE_VOICES is not set.\n");
+		return -1;
+	}
+	return read_frames(data, bytes, state);
+}
+
 struct uade_state *uade_new_state(const struct uade_config *extraconfig)
 {
 	struct uade_state *state;
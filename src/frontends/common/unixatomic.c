@@ -84,3 +84,38 @@ ssize_t uade_atomic_write(int fd, const void *buf, size_t count)
   }
   return bytes_written;
 }
+
+
+/* Writes all of the iovecs. iov is modified if the write is partial. */
+ssize_t uade_atomic_writev(int fd, struct iovec *iov, int iovcnt)
+{
+  ssize_t bytes_written = 0;
+  ssize_t ret;
+  while (iovcnt > 0) {
+    ret = writev(fd, iov, iovcnt);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN) {
+	fd_set s;
+	FD_ZERO(&s);
+	FD_SET(fd, &s);
+	if (select(fd + 1, NULL, &s, NULL, NULL) == 0)
+	  fprintf(stderr, "atomic_writev: very strange. infinite select() returned 0. report this!\n");
+	continue;
+      }
+      return -1;
+    }
+    bytes_written += ret;
+    while (iovcnt > 0 && ret >= (ssize_t) iov->iov_len) {
+      ret -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = ((char *) iov->iov_base) + ret;
+      iov->iov_len -= ret;
+    }
+  }
+  return bytes_written;
+}
@@ -20,8 +20,10 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
@@ -206,6 +208,11 @@ void uade_arch_kill_and_wait_uadecore(struct uade_ipc *ipc, pid_t *uadepid)
 	uade_atomic_close(ipc->in_fd);
 	uade_atomic_close(ipc->out_fd);
 
+	if (ipc->ring != NULL) {
+		munmap(ipc->ring, UADE_RING_SIZE);
+		ipc->ring = NULL;
+	}
+
 	/*
 	 * Wait until one of two happens:
 	 * 1. uadepid is successfully handled (waitpid() returns uadepid)
@@ -216,10 +223,85 @@ void uade_arch_kill_and_wait_uadecore(struct uade_ipc *ipc, pid_t *uadepid)
 	*uadepid = 0;
 }
 
+/*
+ * Close every fd above stderr except keepfd1 and keepfd2. keepfd2 is -1
+ * when there is only one fd to keep. Walking up to _SC_OPEN_MAX takes one
+ * syscall per possible fd, which is most of the spawn time with a high fd
+ * limit, so use close_range() when the kernel has it.
+ */
+static void uade_close_fds_except(int keepfd1, int keepfd2)
+{
+	int fd;
+	int maxfds;
+
+#ifdef SYS_close_range
+	int lo = keepfd1 < keepfd2 ? keepfd1 : keepfd2;
+	int hi = keepfd1 < keepfd2 ? keepfd2 : keepfd1;
+	if (lo < 0)
+		lo = hi;
+	if ((lo == 3 || syscall(SYS_close_range, 3, lo - 1, 0) == 0) &&
+	    (hi <= lo + 1 || syscall(SYS_close_range, lo + 1, hi - 1, 0) == 0) &&
+	    syscall(SYS_close_range, hi + 1, ~0U, 0) == 0)
+		return;
+#endif
+
+	if ((maxfds = sysconf(_SC_OPEN_MAX)) < 0) {
+		maxfds = 1024;
+		fprintf(stderr, "Getting max fds failed. Using %d.\n",
+			maxfds);
+	}
+
+	for (fd = 3; fd < maxfds; fd++) {
+		if (fd != keepfd1 && fd != keepfd2)
+			uade_atomic_close(fd);
+	}
+}
+
+#if defined(SYS_memfd_create) && !defined(MFD_CLOEXEC)
+#define MFD_CLOEXEC 0x0001U
+#endif
+
+/*
+ * Create the shared sample ring. Returns the memfd that is passed to
+ * uadecore, or -1 if the kernel has no memfd_create(), in which case
+ * samples are sent over the socket. The memfd is close-on-exec so that
+ * no other child of the process inherits it. The uadecore child clears
+ * the flag before exec.
+ */
+static int uade_create_ring(uint8_t **ringmap)
+{
+#ifdef SYS_memfd_create
+	void *ring;
+	int fd = syscall(SYS_memfd_create, "uade ring", MFD_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	if (ftruncate(fd, UADE_RING_SIZE) == 0) {
+		ring = mmap(NULL, UADE_RING_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+		if (ring != MAP_FAILED) {
+			*ringmap = ring;
+			return fd;
+		}
+	}
+	uade_warning("Can not create sample ring: %s\n", strerror(errno));
+	uade_atomic_close(fd);
+#endif
+	return -1;
+}
+
+static void uade_release_ring(int ringfd, uint8_t *ringmap)
+{
+	if (ringfd < 0)
+		return;
+	munmap(ringmap, UADE_RING_SIZE);
+	uade_atomic_close(ringfd);
+}
+
 int uade_arch_spawn(struct uade_ipc *ipc, pid_t *uadepid, const char *uadename)
 {
 	int fds[2];
-	char input[32], output[32];
+	int ringfd;
+	char input[32], output[32], ring[32];
+	uint8_t *ringmap = NULL;
 
 	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
 		uade_warning("Can not create socketpair: %s\n",
@@ -227,16 +309,19 @@ int uade_arch_spawn(struct uade_ipc *ipc, pid_t *uadepid, const char *uadename)
 		return -1;
 	}
 
+	ringfd = uade_create_ring(&ringmap);
+
 	*uadepid = fork();
 	if (*uadepid < 0) {
 		fprintf(stderr, "Fork failed: %s\n", strerror(errno));
+		uade_atomic_close(fds[0]);
+		uade_atomic_close(fds[1]);
+		uade_release_ring(ringfd, ringmap);
 		return -1;
 	}
 
 	/* The child (*uadepid == 0) will execute uadecore */
 	if (*uadepid == 0) {
-		int fd;
-		int maxfds;
 		sigset_t sigset;
 
 		/* Unblock SIGTERM in the child, we might need it */
@@ -244,26 +329,31 @@ int uade_arch_spawn(struct uade_ipc *ipc, pid_t *uadepid, const char *uadename)
 		sigaddset(&sigset, SIGTERM);
 		sigprocmask(SIG_UNBLOCK, &sigset, NULL);
 
-		if ((maxfds = sysconf(_SC_OPEN_MAX)) < 0) {
-			maxfds = 1024;
-			fprintf(stderr, "Getting max fds failed. Using %d.\n",
-				maxfds);
-		}
-
 		/*
 		 * Close everything else but stdin, stdout, stderr, and
-		 * in/out fds
+		 * in/out and ring fds
 		 */
-		for (fd = 3; fd < maxfds; fd++) {
-			if (fd != fds[1])
-				uade_atomic_close(fd);
-		}
+		uade_close_fds_except(fds[1], ringfd);
+
+		/*
+		 * Hand the ring over to uadecore. If that fails, uadecore
+		 * runs without it and sends samples over the socket.
+		 */
+		if (ringfd >= 0 && fcntl(ringfd, F_SETFD, 0) < 0)
+			ringfd = -1;
 
 		/* give in/out fds as command line parameters to uadecore */
 		snprintf(input, sizeof input, "%d", fds[1]);
 		snprintf(output, sizeof output, "%d", fds[1]);
 
-		execlp(uadename, uadename, "-i", input, "-o", output, NULL);
+		if (ringfd >= 0) {
+			snprintf(ring, sizeof ring, "%d", ringfd);
+			execlp(uadename, uadename, "-i", input, "-o", output,
+			       "-r", ring, NULL);
+		} else {
+			execlp(uadename, uadename, "-i", input, "-o", output,
+			       NULL);
+		}
 		uade_die("uade execlp (%s) failed: %s\n",
 			 uadename, strerror(errno));
 	}
@@ -273,9 +363,16 @@ int uade_arch_spawn(struct uade_ipc *ipc, pid_t *uadepid, const char *uadename)
 		fprintf(stderr, "Could not close uadecore fds: %s\n",
 			strerror(errno));
 		kill (*uadepid, SIGKILL);
+		uade_atomic_close(fds[0]);
+		uade_release_ring(ringfd, ringmap);
 		return -1;
 	}
 
+	/* The mapping stays valid after the memfd is closed */
+	if (ringfd >= 0)
+		uade_atomic_close(ringfd);
+
 	uade_set_peer(ipc, 1, fds[0], fds[0]);
+	ipc->ring = ringmap;
 	return 0;
 }
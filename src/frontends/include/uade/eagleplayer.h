@@ -38,6 +38,7 @@
 #define ES_SUBSONGS            (1 << 24)
 #define ES_SUBSONG_TIMEOUT     (1 << 25)
 #define ES_TIMEOUT             (1 << 26)
+#define ES_PERIOD_CLAMP        (1 << 27)
 
 #define UADE_WS_DELIMITERS " \t\n"
 
@@ -29,8 +29,8 @@ typedef struct {
 
 struct uade_effect_state {
 	uade_effect_t enabled;
-	int gain;
-	int pan;
+	float gain;
+	float pan;
 	int rate;
 
 	/* Headphone variables */
@@ -54,7 +54,10 @@ void uade_effect_set_sample_rate(struct uade_state *state, int rate);
 /* reset state at start of song */
 void uade_effect_reset_internals(struct uade_state *state);
 
-/* process n frames of sample buffer */
-void uade_effect_run(struct uade_state *s, int16_t *sample, int frames);
+/*
+ * process n frames of sample buffer. The samples are in the sample format
+ * of the state's config.
+ */
+void uade_effect_run(struct uade_state *s, void *samples, int frames);
 
 #endif
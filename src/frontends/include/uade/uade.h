@@ -36,10 +36,16 @@ extern "C"
 
 #include <uade/options.h>
 #include <uade/uadeconfstructure.h>
+#include <uade/uadeconstants.h>
 
 #define UADE_CHANNELS 2
+/* Number of Paula voices. See UC_SEPARATE_VOICES. */
+#define UADE_VOICES 4
+/* Sizes for the default UADE_SAMPLE_S16 format */
 #define UADE_BYTES_PER_SAMPLE 2
 #define UADE_BYTES_PER_FRAME (UADE_CHANNELS * UADE_BYTES_PER_SAMPLE)
+/* Largest frame of any sample format and channel count */
+#define UADE_MAX_BYTES_PER_FRAME (UADE_VOICES * 4)
 
 struct uade_file {
 	char *name;  /* filename */
@@ -111,6 +117,7 @@ enum uade_option {
 	UC_NO_OPTION = 0x1000,
 	UC_BASE_DIR,
 	UC_CONTENT_DETECTION,
+	UC_CPU_PROFILE_FILE,
 	UC_DISABLE_TIMEOUTS,
 	UC_ENABLE_TIMEOUTS,
 	UC_EAGLEPLAYER_OPTION,
@@ -132,9 +139,13 @@ enum uade_option {
 	UC_ONE_SUBSONG,
 	UC_PAL,
 	UC_PANNING_VALUE,
+	UC_PERIOD_CLAMP,
 	UC_PLAYER_FILE,
+	UC_READ_CREDITS,  /* 4 KiB blocks that uadecore renders ahead, 1 to 16 */
 	UC_RESAMPLER,
+	UC_SAMPLE_FORMAT,  /* "s16", "s32" or "float". See uade_read(). */
 	UC_SCORE_FILE,
+	UC_SEPARATE_VOICES,  /* See uade_read_voices() */
 	UC_SILENCE_TIMEOUT_VALUE,
 	UC_SPEED_HACK,
 	UC_SUBSONG_TIMEOUT_VALUE,
@@ -238,12 +249,29 @@ int uade_get_filter_state(const struct uade_state *state);
  *
  * Returns a positive value to indicate a number of sample bytes at 'data'.
  *
- * Sample data is a sequence of frames. Each frame consists of two int16_t
- * samples. The first sample in the frame is for the left channel, and the
- * second sample is for the right channel.
+ * Sample data is a sequence of frames. Each frame consists of two samples.
+ * The first sample in the frame is for the left channel, and the second
+ * sample is for the right channel. Samples are int16_t by default.
+ * Set UC_SAMPLE_FORMAT to "s32" to get int32_t samples, or to "float" to
+ * get float samples in native byte order. Float samples are not clipped,
+ * so loud songs may exceed [-1, 1]. Effects on int16_t samples are computed
+ * in integers, bit-exact with earlier releases. Effects on int32_t and float
+ * samples are computed in float. See uade_get_sample_format() and
+ * uade_get_bytes_per_frame().
  */
 ssize_t uade_read(void *data, size_t bytes, struct uade_state *state);
 
+/*
+ * uade_read_voices() is uade_read() for songs played with UC_SEPARATE_VOICES
+ * set. Each frame consists of four samples, one for each Paula voice from 0
+ * to 3, before they are mixed together. Voices 0 and 3 sum up to the left
+ * channel of uade_read(), and voices 1 and 2 to the right channel. The Amiga
+ * filter is applied to each voice, but effects are not applied. uade_read()
+ * can not be used in this mode, and uade_read_voices() can not be used
+ * without it.
+ */
+ssize_t uade_read_voices(void *data, size_t bytes, struct uade_state *state);
+
 /*
  * Various notifications that libuade and uadecore send. Currently they are
  * purely informational notifications, so you don't have to handle them.
@@ -314,6 +342,18 @@ void uade_cleanup_notification(struct uade_notification *notification);
 /* Returns sampling rate of current state */
 int uade_get_sampling_rate(const struct uade_state *state);
 
+/* Returns sample format of current state */
+enum uade_sample_format uade_get_sample_format(const struct uade_state *state);
+
+/*
+ * Returns number of samples in a frame: UADE_CHANNELS, or UADE_VOICES with
+ * UC_SEPARATE_VOICES.
+ */
+int uade_get_channels(const struct uade_state *state);
+
+/* Returns number of bytes in a frame of the current sample format */
+int uade_get_bytes_per_frame(const struct uade_state *state);
+
 /*
  * uade_get_song_info() can be called after successful call to uade_play()
  * to get information about module, player and format name, and the
@@ -44,6 +44,7 @@ struct uade_config {
 	UADE_PATH_CONFIG(score_file);
 	UADE_PATH_CONFIG(uadecore_file);
 	UADE_PATH_CONFIG(uae_config_file);
+	UADE_PATH_CONFIG(cpu_profile_file);
 
 	UADE_CHAR_CONFIG(content_detection);
 
@@ -66,6 +67,11 @@ struct uade_config {
 	char *resampler;
 	char resampler_set;
 
+	/* enum uade_sample_format, not settable from uade.conf */
+	UADE_CHAR_CONFIG(sample_format);
+	/* output Paula voices separately, not settable from uade.conf */
+	UADE_CHAR_CONFIG(separate_voices);
+
 	UADE_CHAR_CONFIG(no_ep_end);
 	UADE_CHAR_CONFIG(no_filter);
 	UADE_CHAR_CONFIG(no_postprocessing);
@@ -73,6 +79,8 @@ struct uade_config {
 	UADE_CHAR_CONFIG(one_subsong);
 	UADE_FLOAT_CONFIG(panning);		/* should be removed */
 	UADE_CHAR_CONFIG(panning_enable);
+	UADE_CHAR_CONFIG(period_clamp);
+	UADE_INT_CONFIG(read_credits);
 	UADE_INT_CONFIG(silence_timeout);
 	UADE_CHAR_CONFIG(speed_hack);
 	UADE_INT_CONFIG(subsong_timeout);
@@ -4,4 +4,16 @@
 /* You must not change anything */
 #define UADE_DEFAULT_FREQUENCY 44100
 
+/*
+ * Sample formats produced by uadecore and uade_read(). A frame is two
+ * samples, left and right, or four voice samples with UC_SEPARATE_VOICES
+ * (see uade_read_voices()). See UC_SAMPLE_FORMAT.
+ */
+enum uade_sample_format {
+	UADE_SAMPLE_S16 = 0,  /* int16_t. This is the default. */
+	UADE_SAMPLE_S32,      /* int32_t, full scale is [-2^31, 2^31 - 1] */
+	UADE_SAMPLE_FLOAT,    /* float, full scale is [-1, 1]. Not clipped. */
+	UADE_SAMPLE_FORMAT_UPPER_BOUND
+};
+
 #endif
@@ -10,6 +10,27 @@
 #define UADE_MAX_MESSAGE_SIZE (8 + 4096)
 #define UADE_MAX_NAME_SIZE 4000
 
+/*
+ * UADE_COMMAND_READ asks for up to UADE_MAX_READ_SIZE bytes. uadecore
+ * answers with data messages of at most UADE_READ_BLOCK_SIZE bytes each,
+ * and sends the token after the last one. The frontend consumes the
+ * blocks while uadecore renders the rest of the request.
+ */
+#define UADE_READ_BLOCK_SIZE 4096
+#define UADE_MAX_READ_CREDITS 16
+#define UADE_MAX_READ_SIZE (UADE_READ_BLOCK_SIZE * UADE_MAX_READ_CREDITS)
+
+/*
+ * Optional shared memory ring for sample data. uadecore renders each block
+ * straight into the next slot of the ring and replies with
+ * UADE_REPLY_RING_DATA, which carries only the offset and the size of the
+ * slot. Samples in the ring are in host byte order. The ring holds a whole
+ * read request, so a slot is not reused before the frontend has copied it.
+ */
+#define UADE_RING_SLOT_SIZE UADE_READ_BLOCK_SIZE
+#define UADE_RING_SLOTS UADE_MAX_READ_CREDITS
+#define UADE_RING_SIZE (UADE_RING_SLOT_SIZE * UADE_RING_SLOTS)
+
 enum uade_msgtype {
 	UADE_MSG_FIRST = 0,
 	UADE_COMMAND_ACTIVATE_DEBUGGER,
@@ -41,6 +62,17 @@ enum uade_msgtype {
 	UADE_REPLY_MODULENAME,
 	UADE_REPLY_FORMATNAME,
 	UADE_REPLY_DATA,
+	/*
+	 * New message types go here, just before UADE_MSG_LAST, so that the
+	 * values above stay the same for every libuade and uadecore.
+	 */
+	UADE_COMMAND_CPU_PROFILE,
+	UADE_REPLY_CPU_PROFILE,
+	UADE_COMMAND_SET_SAMPLE_FORMAT,
+	UADE_COMMAND_SEPARATE_VOICES,
+	UADE_COMMAND_PERIOD_CLAMP,
+	UADE_REPLY_RING_DATA,
+	UADE_COMMAND_SAMPLE_BYTE_ORDER, /* optional, big endian if not sent */
 	UADE_MSG_LAST
 };
 
@@ -79,6 +111,8 @@ struct uade_ipc {
 	unsigned int inputbytes;
 	char inputbuffer[UADE_MAX_MESSAGE_SIZE];
 	enum uade_control_state state;
+	uint8_t *ring; /* UADE_RING_SIZE bytes of shared memory, or NULL */
+	int native_samples; /* uadecore: send samples in host byte order */
 };
 
 void uade_check_fix_string(struct uade_msg *um, size_t maxlen);
@@ -94,6 +128,7 @@ int uade_receive_string(char *s, enum uade_msgtype msgtype, size_t maxlen, struc
 struct uade_file *uade_request_amiga_file(const char *name, struct uade_ipc *ipc);
 int uade_send_file(const struct uade_file *f, struct uade_ipc *ipc);
 int uade_send_message(struct uade_msg *um, struct uade_ipc *ipc);
+int uade_send_message_data(enum uade_msgtype com, const void *data, uint32_t size, struct uade_ipc *ipc);
 int uade_send_short_message(enum uade_msgtype msgtype, struct uade_ipc *ipc);
 int uade_send_string(enum uade_msgtype msgtype, const char *str, struct uade_ipc *ipc);
 int uade_send_u32(enum uade_msgtype com, uint32_t u, struct uade_ipc *ipc);
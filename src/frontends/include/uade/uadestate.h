@@ -79,7 +79,10 @@ struct uade_song_state {
 	uint64_t seeksongoffs;    /* byte offset to seek to */
 	uint64_t seeksubsongoffs; /* byte offset to seek to */
 
-	unsigned int bytesrequested; /* bytes requested from uadecore */
+	/* bytes requested from uadecore and not received yet */
+	unsigned int bytesrequested;
+	/* drop data until the token, because libuade ended the song */
+	int skipdata;
 
 	struct uade_event endevent;
 
@@ -3,10 +3,12 @@
 
 #include <stdio.h>
 #include <unistd.h>
+#include <sys/uio.h>
 
 int uade_atomic_close(int fd);
 int uade_atomic_dup2(int oldfd, int newfd);
 ssize_t uade_atomic_read(int fd, const void *buf, size_t count);
 ssize_t uade_atomic_write(int fd, const void *buf, size_t count);
+ssize_t uade_atomic_writev(int fd, struct iovec *iov, int iovcnt);
 
 #endif
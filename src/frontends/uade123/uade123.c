@@ -228,6 +228,8 @@ int main(int argc, char *argv[])
 		{"one",              0, NULL, '1'},
 		{"pal",              0, NULL, UC_PAL},
 		{"panning",          1, NULL, 'p'},
+		{"period-clamp",     0, NULL, UC_PERIOD_CLAMP},
+		{"read-credits",     1, NULL, UC_READ_CREDITS},
 		{"recursive",        0, NULL, 'r'},
 		{"repeat",           0, NULL, OPT_REPEAT},
 		{"resampler",        1, NULL, UC_RESAMPLER},
@@ -448,6 +450,7 @@ int main(int argc, char *argv[])
 		case UC_FILTER_TYPE:
 		case UC_FORCE_LED:
 		case UC_FREQUENCY:
+		case UC_READ_CREDITS:
 		case UC_RESAMPLER:
 			uade_config_set_option(uc_cmdline, ret, optarg);
 			break;
@@ -459,6 +462,7 @@ int main(int argc, char *argv[])
 		case UC_HEADPHONES2:
 		case UC_NTSC:
 		case UC_PAL:
+		case UC_PERIOD_CLAMP:
 		case UC_SPEED_HACK:
 			uade_config_set_option(uc_cmdline, ret, NULL);
 			break;
@@ -647,7 +651,12 @@ static void print_help(void)
 " --pal,              Set PAL mode (default)\n"
 " -p x, --panning=x,  Set panning value in range [0, 2]. 0 is full stereo,\n"
 "                     1 is mono, and 2 is inverse stereo. The default is 0,7.\n"
+" --period-clamp,     Raise Paula periods below 16 to 16. Saves cpu time with\n"
+"                     some customs, but may break them.\n"
 " -P filename,        Set player name\n"
+" --read-credits=n,   Let uadecore render n blocks of 4 KiB ahead, 1 to 16.\n"
+"                     The default is 4. Larger values render files faster,\n"
+"                     but subsong changes and seeks take effect later.\n"
 " -r, --recursive,    Recursive directory scan\n"
 " --repeat,           Play playlist over and over again\n"
 " --resampler=x       Set resampling method to x, where x = default, sinc\n"
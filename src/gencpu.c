@@ -32,6 +32,29 @@ static int using_prefetch;
 static int using_exception_3;
 static int cpu_level;
 
+/* Non-zero when generating the threaded (computed goto) interpreter into
+ * cpuemuth.c instead of the handler functions. */
+static int threaded;
+
+/* Non-zero when the common ALU handlers leave flag evaluation to
+ * lazy_flags_eval() (--lazy-flags). */
+static int lazy_flags;
+
+/* Opcode pairs to fuse into superinstructions (--profile) */
+#define MAX_FUSE_PAIRS 32
+
+struct fuse_pair {
+    unsigned long pair;
+    unsigned long long count;
+};
+
+static struct fuse_pair *fuse_pairs;
+static int n_fuse_pairs;
+
+/* Postfix of the handler function of each opcode in the table that is
+ * being generated, -1 if the opcode has no function of its own. */
+static int *func_postfix;
+
 /* For the current opcode, the next lower level that will have different code.
  * Initialized to -1 for each opcode. If it remains unchanged, indicates we
  * are done with that opcode.  */
@@ -711,8 +734,46 @@ static void genflags_normal (flagtypes type, wordsizes size, char *value, char *
     }
 }
 
+/* Store the operands of a logical, ADD, SUB or CMP operation in lazyflags
+ * instead of computing C, Z, N and V. The result value is declared exactly
+ * like genflags_normal() does. X is still set here, since lazyflags only
+ * holds the last operation. Returns 0 for flag types that are computed
+ * eagerly. */
+static int genflags_lazy (flagtypes type, wordsizes size, char *value, char *src, char *dst)
+{
+    const char *scast = size == sz_byte ? "uae_s8" : size == sz_word ? "uae_s16" : "uae_s32";
+    const char *ucast = size == sz_byte ? "uae_u8" : size == sz_word ? "uae_u16" : "uae_u32";
+    const char *kind;
+
+    switch (type) {
+     case flag_logical: kind = "LAZY_LOGICAL"; break;
+     case flag_add: kind = "LAZY_ADD"; break;
+     case flag_sub: kind = "LAZY_SUB"; break;
+     case flag_cmp: kind = "LAZY_CMP"; break;
+     default:
+	return 0;
+    }
+
+    if (type == flag_logical) {
+	printf ("\tlazyflags.res = %s;\n", value);
+    } else {
+	start_brace ();
+	printf ("uae_u32 %s = ((%s)(%s)) %c ((%s)(%s));\n", value,
+		scast, dst, type == flag_add ? '+' : '-', scast, src);
+	printf ("\tlazyflags.src = %s;\n", src);
+	printf ("\tlazyflags.dst = %s;\n", dst);
+    }
+    if (type == flag_add)
+	printf ("\tSET_XFLG (((%s)(~%s)) < ((%s)(%s)));\n", ucast, dst, ucast, src);
+    printf ("\tlazyflags.op = LAZY_OP (%s, %d);\n", kind, size);
+    return 1;
+}
+
 static void genflags (flagtypes type, wordsizes size, char *value, char *src, char *dst)
 {
+    if (lazy_flags && genflags_lazy (type, size, value, src, dst))
+	return;
+
 #ifdef X86_ASSEMBLY
     switch (type) {
      case flag_add:
@@ -957,6 +1018,18 @@ static void genflags (flagtypes type, wordsizes size, char *value, char *src, ch
     genflags_normal (type, size, value, src, dst);
 }
 
+/* For handlers that set C right after the result flags, like the memory
+ * shifts and rotates. A lazy operation would be flushed immediately by
+ * SET_CFLG, so evaluate the flags eagerly. */
+static void genflags_eager (flagtypes type, wordsizes size, char *value, char *src, char *dst)
+{
+    int lazy = lazy_flags;
+
+    lazy_flags = 0;
+    genflags (type, size, value, src, dst);
+    lazy_flags = lazy;
+}
+
 static void force_range_for_rox (const char *var, wordsizes size)
 {
     /* Could do a modulo operation here... which one is faster? */
@@ -1469,7 +1542,7 @@ static void gen_opcode (unsigned long int opcode)
 	    }
 	}
 	genamode (curi->smode, "srcreg", curi->size, "src", 1, 0);
-	printf ("\tif (!cctrue(%d)) goto didnt_jump;\n", curi->cc);
+	printf ("\tif (!cctrue(%d)) goto didnt_jump%d;\n", curi->cc, endlabelno);
 	if (using_exception_3) {
 	    printf ("\tif (src & 1) {\n");
 	    printf ("\t\tlast_addr_for_exception_3 = m68k_getpc() + 2;\n");
@@ -1485,7 +1558,7 @@ static void gen_opcode (unsigned long int opcode)
 #endif
 	fill_prefetch_0 ();
 	printf ("\tgoto %s;\n", endlabelstr);
-	printf ("didnt_jump:;\n");
+	printf ("didnt_jump%d:;\n", endlabelno);
 	need_endlabel = 1;
 	break;
      case i_LEA:
@@ -1876,7 +1949,7 @@ static void gen_opcode (unsigned long int opcode)
 	printf ("\tuae_u32 sign = %s & val;\n", cmask (curi->size));
 	printf ("\tuae_u32 cflg = val & 1;\n");
 	printf ("\tval = (val >> 1) | sign;\n");
-	genflags (flag_logical, curi->size, "val", "", "");
+	genflags_eager (flag_logical, curi->size, "val", "", "");
 	printf ("\tSET_CFLG (cflg);\n");
 	duplicate_carry ();
 	genastore ("val", curi->smode, "srcreg", curi->size, "data");
@@ -1893,7 +1966,7 @@ static void gen_opcode (unsigned long int opcode)
 	printf ("\tuae_u32 sign = %s & val;\n", cmask (curi->size));
 	printf ("\tuae_u32 sign2;\n");
 	printf ("\tval <<= 1;\n");
-	genflags (flag_logical, curi->size, "val", "", "");
+	genflags_eager (flag_logical, curi->size, "val", "", "");
 	printf ("\tsign2 = %s & val;\n", cmask (curi->size));
 	printf ("\tSET_CFLG (sign != 0);\n");
 	duplicate_carry ();
@@ -1912,7 +1985,7 @@ static void gen_opcode (unsigned long int opcode)
 	}
 	printf ("\tuae_u32 carry = val & 1;\n");
 	printf ("\tval >>= 1;\n");
-	genflags (flag_logical, curi->size, "val", "", "");
+	genflags_eager (flag_logical, curi->size, "val", "", "");
 	printf ("SET_CFLG (carry);\n");
 	duplicate_carry ();
 	genastore ("val", curi->smode, "srcreg", curi->size, "data");
@@ -1928,7 +2001,7 @@ static void gen_opcode (unsigned long int opcode)
 	}
 	printf ("\tuae_u32 carry = val & %s;\n", cmask (curi->size));
 	printf ("\tval <<= 1;\n");
-	genflags (flag_logical, curi->size, "val", "", "");
+	genflags_eager (flag_logical, curi->size, "val", "", "");
 	printf ("SET_CFLG (carry >> %d);\n", bit_size (curi->size) - 1);
 	duplicate_carry ();
 	genastore ("val", curi->smode, "srcreg", curi->size, "data");
@@ -1945,7 +2018,7 @@ static void gen_opcode (unsigned long int opcode)
 	printf ("\tuae_u32 carry = val & %s;\n", cmask (curi->size));
 	printf ("\tval <<= 1;\n");
 	printf ("\tif (carry)  val |= 1;\n");
-	genflags (flag_logical, curi->size, "val", "", "");
+	genflags_eager (flag_logical, curi->size, "val", "", "");
 	printf ("SET_CFLG (carry >> %d);\n", bit_size (curi->size) - 1);
 	genastore ("val", curi->smode, "srcreg", curi->size, "data");
 	break;
@@ -1961,7 +2034,7 @@ static void gen_opcode (unsigned long int opcode)
 	printf ("\tuae_u32 carry = val & 1;\n");
 	printf ("\tval >>= 1;\n");
 	printf ("\tif (carry) val |= %s;\n", cmask (curi->size));
-	genflags (flag_logical, curi->size, "val", "", "");
+	genflags_eager (flag_logical, curi->size, "val", "", "");
 	printf ("SET_CFLG (carry);\n");
 	genastore ("val", curi->smode, "srcreg", curi->size, "data");
 	break;
@@ -1977,7 +2050,7 @@ static void gen_opcode (unsigned long int opcode)
 	printf ("\tuae_u32 carry = val & %s;\n", cmask (curi->size));
 	printf ("\tval <<= 1;\n");
 	printf ("\tif (GET_XFLG) val |= 1;\n");
-	genflags (flag_logical, curi->size, "val", "", "");
+	genflags_eager (flag_logical, curi->size, "val", "", "");
 	printf ("SET_CFLG (carry >> %d);\n", bit_size (curi->size) - 1);
 	duplicate_carry ();
 	genastore ("val", curi->smode, "srcreg", curi->size, "data");
@@ -1994,7 +2067,7 @@ static void gen_opcode (unsigned long int opcode)
 	printf ("\tuae_u32 carry = val & 1;\n");
 	printf ("\tval >>= 1;\n");
 	printf ("\tif (GET_XFLG) val |= %s;\n", cmask (curi->size));
-	genflags (flag_logical, curi->size, "val", "", "");
+	genflags_eager (flag_logical, curi->size, "val", "", "");
 	printf ("SET_CFLG (carry);\n");
 	duplicate_carry ();
 	genastore ("val", curi->smode, "srcreg", curi->size, "data");
@@ -2317,6 +2390,11 @@ static void generate_includes (FILE * f)
     fprintf (f, "#include \"newcpu.h\"\n");
     fprintf (f, "#include \"compiler.h\"\n");
     fprintf (f, "#include \"cputbl.h\"\n");
+    if (lazy_flags) {
+	fprintf (f, "#ifndef UADE_LAZY_FLAGS\n");
+	fprintf (f, "#error \"Generated with --lazy-flags, compile with -DUADE_LAZY_FLAGS\"\n");
+	fprintf (f, "#endif\n");
+    }
 }
 
 static int postfix;
@@ -2339,14 +2417,22 @@ static void generate_one_opcode (int rp)
     if (table68k[opcode].handler != -1)
 	return;
 
-    if (opcode_next_clev[rp] != cpu_level) {
+    if (threaded) {
+	/* Labels are local to the runner, so every table gets its own copy
+	 * of each handler. */
+	fprintf (stblfile, "{ &&th_op_%lx, %ld }, /* %s */\n", opcode, opcode, lookuptab[i].name);
+	printf ("th_op_%lx: /* %s */\n{\n", opcode, lookuptab[i].name);
+    } else if (opcode_next_clev[rp] != cpu_level) {
 	fprintf (stblfile, "{ op_%lx_%d, 0, %ld }, /* %s */\n", opcode, opcode_last_postfix[rp],
 		 opcode, lookuptab[i].name);
+	func_postfix[opcode] = opcode_last_postfix[rp];
 	return;
+    } else {
+	fprintf (stblfile, "{ op_%lx_%d, 0, %ld }, /* %s */\n", opcode, postfix, opcode, lookuptab[i].name);
+	func_postfix[opcode] = postfix;
+	fprintf (headerfile, "extern cpuop_func op_%lx_%d;\n", opcode, postfix);
+	printf ("unsigned long REGPARAM2 op_%lx_%d(uae_u32 opcode) /* %s */\n{\n", opcode, postfix, lookuptab[i].name);
     }
-    fprintf (stblfile, "{ op_%lx_%d, 0, %ld }, /* %s */\n", opcode, postfix, opcode, lookuptab[i].name);
-    fprintf (headerfile, "extern cpuop_func op_%lx_%d;\n", opcode, postfix);
-    printf ("unsigned long REGPARAM2 op_%lx_%d(uae_u32 opcode) /* %s */\n{\n", opcode, postfix, lookuptab[i].name);
 
     switch (table68k[opcode].stype) {
      case 0: smsk = 7; break;
@@ -2460,12 +2546,225 @@ static void generate_one_opcode (int rp)
     gen_opcode (opcode);
     if (need_endlabel)
 	printf ("%s: ;\n", endlabelstr);
-    printf ("return %d;\n", insn_n_cycles);
+    if (threaded)
+	printf ("TH_NEXT (%d);\n", insn_n_cycles);
+    else
+	printf ("return %d;\n", insn_n_cycles);
     printf ("}\n");
     opcode_next_clev[rp] = next_cpu_level;
     opcode_last_postfix[rp] = postfix;
 }
 
+/* Writes the opcode -> row mapping of the current op_smalltbl_N, which is
+ * what build_cpufunctbl() used to work out from table68k at startup.
+ * Opcodes that are illegal on this CPU level map to the terminating row. */
+static void generate_functbl_index (void)
+{
+    int rp, nrows = 0;
+    long int opcode;
+    int *row = (int *) xmalloc (65536 * sizeof (int));
+
+    for (opcode = 0; opcode < 65536; opcode++)
+	row[opcode] = -1;
+    for (rp = 0; rp < nr_cpuop_funcs; rp++) {
+	opcode = opcode_map[rp];
+	if (table68k[opcode].mnemo == i_ILLG
+	    || table68k[opcode].clev > cpu_level
+	    || table68k[opcode].handler != -1)
+	    continue;
+	row[opcode] = nrows++;
+    }
+
+    fprintf (stblfile, "const uae_u16 op_functbl_idx_%d[65536] = {\n", postfix);
+    for (opcode = 0; opcode < 65536; opcode++) {
+	int r = nrows;
+
+	if (table68k[opcode].mnemo != i_ILLG
+	    && table68k[opcode].clev <= cpu_level)
+	{
+	    long int h = table68k[opcode].handler;
+	    r = row[h == -1 ? opcode : h];
+	    if (r < 0)
+		abort ();
+	}
+	fprintf (stblfile, "%d,%c", r, (opcode & 15) == 15 ? '\n' : ' ');
+    }
+    fprintf (stblfile, "};\n");
+    free (row);
+}
+
+static int fuse_pair_cmp (const void *a, const void *b)
+{
+    const struct fuse_pair *pa = a, *pb = b;
+    return pa->pair < pb->pair ? -1 : pa->pair > pb->pair;
+}
+
+static int fuse_count_cmp (const void *a, const void *b)
+{
+    const struct fuse_pair *pa = a, *pb = b;
+    return pa->count < pb->count ? 1 : pa->count > pb->count ? -1 : fuse_pair_cmp (a, b);
+}
+
+/* Reads the "pair" lines of a profile written by libuade (cpu_profile_file
+ * in uade.conf), adds up the counts of all songs and keeps the hottest
+ * pairs. */
+static void read_profile (const char *name)
+{
+    FILE *f = fopen (name, "r");
+    char line[1024];
+    unsigned int a, b;
+    unsigned long long count;
+    int n = 0, space = 0, i, j;
+
+    if (f == NULL) {
+	fprintf (stderr, "gencpu: Can not open profile %s\n", name);
+	exit (1);
+    }
+    while (fgets (line, sizeof line, f) != NULL) {
+	if (sscanf (line, "pair %x %x %llu", &a, &b, &count) != 3
+	    || a > 0xffff || b > 0xffff)
+	    continue;
+	if (n == space) {
+	    space = space ? 2 * space : 1024;
+	    fuse_pairs = realloc (fuse_pairs, space * sizeof fuse_pairs[0]);
+	    if (fuse_pairs == NULL) {
+		fprintf (stderr, "gencpu: Out of memory\n");
+		exit (1);
+	    }
+	}
+	fuse_pairs[n].pair = (a << 16) | b;
+	fuse_pairs[n].count = count;
+	n++;
+    }
+    fclose (f);
+
+    qsort (fuse_pairs, n, sizeof fuse_pairs[0], fuse_pair_cmp);
+    for (i = 0, j = -1; i < n; i++) {
+	if (j >= 0 && fuse_pairs[j].pair == fuse_pairs[i].pair)
+	    fuse_pairs[j].count += fuse_pairs[i].count;
+	else
+	    fuse_pairs[++j] = fuse_pairs[i];
+    }
+    n = j + 1;
+    qsort (fuse_pairs, n, sizeof fuse_pairs[0], fuse_count_cmp);
+    n_fuse_pairs = n < MAX_FUSE_PAIRS ? n : MAX_FUSE_PAIRS;
+}
+
+/* Name of the function that handles opcode in the current table */
+static const char *fuse_func (unsigned long opcode)
+{
+    static char name[2][32];
+    static int k;
+    long int root = table68k[opcode].handler == -1 ? (long int) opcode : table68k[opcode].handler;
+
+    k ^= 1;
+    sprintf (name[k], "op_%lx_%d", root, func_postfix[root]);
+    return name[k];
+}
+
+static int fuse_legal (unsigned long opcode)
+{
+    long int root = table68k[opcode].handler == -1 ? (long int) opcode : table68k[opcode].handler;
+
+    return (table68k[opcode].mnemo != i_ILLG
+	    && table68k[opcode].clev <= cpu_level
+	    && func_postfix[root] >= 0);
+}
+
+/* Writes one superinstruction for each first opcode of the fused pairs
+ * and op_fusetbl_N, which build_cpufunctbl() lays over the plain table.
+ * A superinstruction runs the first opcode and, when the next opcode is
+ * one of its profiled successors, the second one right away. */
+static void generate_fused_handlers (void)
+{
+    int i, j;
+    unsigned long a, b;
+
+    for (i = 0; i < n_fuse_pairs; i++) {
+	a = fuse_pairs[i].pair >> 16;
+	for (j = 0; j < i; j++) {
+	    if ((fuse_pairs[j].pair >> 16) == a)
+		break;
+	}
+	if (j < i || !fuse_legal (a))
+	    continue;
+	fprintf (stblfile, "static unsigned long REGPARAM2 op_fuse_%04lx_%d (uae_u32 opcode)\n{\n", a, postfix);
+	fprintf (stblfile, "\tunsigned long c = %s (opcode);\n", fuse_func (a));
+	fprintf (stblfile, "\tif (regs.spcflags || uadecore_reboot)\n\t\treturn c;\n");
+	fprintf (stblfile, "\tswitch (GET_OPCODE) {\n");
+	for (j = i; j < n_fuse_pairs; j++) {
+	    if ((fuse_pairs[j].pair >> 16) != a)
+		continue;
+	    b = fuse_pairs[j].pair & 0xffff;
+	    if (!fuse_legal (b))
+		continue;
+	    fprintf (stblfile, "\tcase FUSE_OPCODE (0x%04lx): /* %llu */\n", b, fuse_pairs[j].count);
+	    fprintf (stblfile, "\t\tif (fuse_cycles (c))\n");
+	    fprintf (stblfile, "\t\t\treturn %s (FUSE_OPCODE (0x%04lx));\n", fuse_func (b), b);
+	    fprintf (stblfile, "\t\tbreak;\n");
+	}
+	fprintf (stblfile, "\t}\n\treturn c;\n}\n");
+    }
+
+    fprintf (stblfile, "struct cputbl op_fusetbl_%d[] = {\n", postfix);
+    for (i = 0; i < n_fuse_pairs; i++) {
+	a = fuse_pairs[i].pair >> 16;
+	for (j = 0; j < i; j++) {
+	    if ((fuse_pairs[j].pair >> 16) == a)
+		break;
+	}
+	if (j == i && fuse_legal (a))
+	    fprintf (stblfile, "{ op_fuse_%04lx_%d, 0, %ld },\n", a, postfix, a);
+    }
+    fprintf (stblfile, "{ 0, 0, 0 }};\n");
+}
+
+/* Helpers of the superinstructions. The second opcode of a pair only runs
+ * inside the first one's handler when m68k_run_1() would not do anything in
+ * between: no special flag is set and no event is due within the cycles of
+ * the first one. The cycles are then added like do_cycles() would do. */
+static void generate_fuse_helpers (void)
+{
+    fprintf (stblfile, "#include \"events.h\"\n");
+    fprintf (stblfile, "#include \"uadectl.h\"\n\n");
+    fprintf (stblfile, "#ifdef HAVE_GET_WORD_UNSWAPPED\n");
+    fprintf (stblfile, "#define FUSE_OPCODE(o) ((((o) >> 8) & 255) | (((o) & 255) << 8))\n");
+    fprintf (stblfile, "#else\n");
+    fprintf (stblfile, "#define FUSE_OPCODE(o) (o)\n");
+    fprintf (stblfile, "#endif\n\n");
+    fprintf (stblfile, "static inline int fuse_cycles (unsigned long c)\n{\n");
+    fprintf (stblfile, "\tunsigned long dist = nextevent - cycles;\n");
+    fprintf (stblfile, "\tif (uadecore_time_critical)\n\t\tc = 1;\n");
+    fprintf (stblfile, "\tc &= cycles_mask;\n");
+    fprintf (stblfile, "\tc |= cycles_val;\n");
+    fprintf (stblfile, "\tif (dist != 0 && dist <= c)\n\t\treturn 0;\n");
+    fprintf (stblfile, "\tcycles += c;\n");
+    fprintf (stblfile, "\treturn 1;\n}\n\n");
+}
+
+/* Writes the merged table68k, so that uadecore does not have to run
+ * read_table68k() and do_merges() on every start. */
+static void generate_table68k (void)
+{
+    long int opcode;
+
+    fprintf (stblfile, "const struct instr table68k_data[65536] = {\n");
+    for (opcode = 0; opcode < 65536; opcode++) {
+	struct instr *dp = table68k + opcode;
+
+	if (dp->mnemo == i_ILLG && dp->handler == -1) {
+	    fprintf (stblfile, "{ -1 },\n");
+	    continue;
+	}
+	fprintf (stblfile, "{ %ld, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, %d, 0, %d, 0 },\n",
+		 dp->handler, dp->dreg, dp->sreg, dp->dpos, dp->spos, dp->sduse,
+		 dp->flagdead, dp->flaglive, dp->mnemo, dp->cc, dp->plev,
+		 dp->size, dp->smode, dp->stype, dp->dmode, dp->suse, dp->duse,
+		 dp->clev);
+    }
+    fprintf (stblfile, "};\n");
+}
+
 static void generate_func (void)
 {
     int i, j, rp;
@@ -2482,6 +2781,8 @@ static void generate_func (void)
 		opcode_next_clev[rp] = 0;
 	}
 	postfix = i;
+	for (rp = 0; rp < 65536; rp++)
+	    func_postfix[rp] = -1;
 	fprintf (stblfile, "struct cputbl op_smalltbl_%d[] = {\n", postfix);
 
 	/* sam: this is for people with low memory (eg. me :)) */
@@ -2511,12 +2812,99 @@ static void generate_func (void)
 	}
 
 	fprintf (stblfile, "{ 0, 0, 0 }};\n");
+	generate_functbl_index ();
+	generate_fused_handlers ();
     }
 
+    generate_table68k ();
+}
+
+/* The threaded flavour puts all handlers of one table into a single runner
+ * function and jumps from handler to handler through a label table
+ * (computed goto).  The runner only returns to m68k_run_threaded() when a
+ * special flag is set or the core is being rebooted, which is the same
+ * point where m68k_run_1() calls do_specialties().  */
+static void generate_threaded_func (void)
+{
+    int i, rp;
+    int c;
+
+    printf ("#include \"events.h\"\n");
+    printf ("#include \"uadectl.h\"\n\n");
+
+    printf ("#define TH_NEXT(c) do { \\\n"
+	    "    unsigned long th_cycles = uadecore_time_critical ? 1 : (c); \\\n"
+	    "    th_cycles &= cycles_mask; \\\n"
+	    "    th_cycles |= cycles_val; \\\n"
+	    "    if ((nextevent - cycles) <= th_cycles) \\\n"
+	    "	do_cycles_slow (th_cycles); \\\n"
+	    "    else \\\n"
+	    "	cycles += th_cycles; \\\n"
+	    "    if (regs.spcflags || uadecore_reboot) \\\n"
+	    "	return; \\\n"
+	    "    opcode = GET_OPCODE; \\\n"
+	    "    goto *th_table[opcode]; \\\n"
+	    "} while (0)\n\n");
+
+    printf ("#if !defined(TABLE_0) && !defined(TABLE_1) && !defined(TABLE_2) && "
+	    "!defined(TABLE_3) && !defined(TABLE_4)\n");
+    for (i = 0; i < 5; i++)
+	printf ("#define TABLE_%d 1\n", i);
+    printf ("#endif\n");
+
+    using_prefetch = 0;
+    using_exception_3 = 0;
+    for (i = 0; i < 5; i++) {
+	cpu_level = 3 - i;
+	if (i == 4) {
+	    cpu_level = 0;
+	    using_prefetch = 1;
+	    using_exception_3 = 1;
+	}
+	postfix = i;
+
+	stblfile = tmpfile ();
+	if (stblfile == NULL) {
+	    perror ("gencpu: tmpfile");
+	    exit (1);
+	}
+
+	printf ("\n#ifdef TABLE_%d\n", postfix);
+	printf ("void m68k_run_threaded_%d (void)\n{\n", postfix);
+	printf ("static void *th_table[65536];\n");
+	printf ("static int th_table_ready;\n");
+	printf ("uae_u32 opcode;\n");
+	printf ("if (!th_table_ready) goto th_build;\n");
+	printf ("th_start:\n");
+	printf ("opcode = GET_OPCODE;\n");
+	printf ("goto *th_table[opcode];\n");
+
+	for (rp = 0; rp < nr_cpuop_funcs; rp++)
+	    generate_one_opcode (rp);
+
+	printf ("th_illg:\n{\n");
+	printf ("op_illg (opcode);\n");
+	printf ("TH_NEXT (4);\n}\n");
+
+	printf ("th_build:\n{\n");
+	printf ("static const struct cputhr th_smalltbl[] = {\n");
+	rewind (stblfile);
+	while ((c = fgetc (stblfile)) != EOF)
+	    putchar (c);
+	fclose (stblfile);
+	stblfile = NULL;
+	printf ("{ 0, 0 }};\n");
+	printf ("build_cputhrtbl (th_table, th_smalltbl, op_functbl_idx_%d, &&th_illg);\n", postfix);
+	printf ("th_table_ready = 1;\n");
+	printf ("goto th_start;\n}\n");
+	printf ("}\n#endif\n");
+    }
 }
 
 int main (int argc, char **argv)
 {
+    int i;
+
     read_table68k ();
     do_merges ();
 
@@ -2524,20 +2912,37 @@ int main (int argc, char **argv)
     opcode_last_postfix = (int *) xmalloc (sizeof (int) * nr_cpuop_funcs);
     opcode_next_clev = (int *) xmalloc (sizeof (int) * nr_cpuop_funcs);
     counts = (unsigned long *) xmalloc (65536 * sizeof (unsigned long));
+    func_postfix = (int *) xmalloc (65536 * sizeof (int));
     read_counts ();
 
     /* It would be a lot nicer to put all in one file (we'd also get rid of
      * cputbl.h that way), but cpuopti can't cope.  That could be fixed, but
      * I don't dare to touch the 68k version.  */
 
-    headerfile = fopen ("cputbl.h", "wb");
-    stblfile = fopen ("cpustbl.c", "wb");
-    freopen ("cpuemu.c", "wb", stdout);
+    for (i = 1; i < argc; i++) {
+	if (strcmp (argv[i], "--threaded") == 0)
+	    threaded = 1;
+	else if (strcmp (argv[i], "--lazy-flags") == 0)
+	    lazy_flags = 1;
+	else if (strcmp (argv[i], "--profile") == 0 && i + 1 < argc)
+	    read_profile (argv[++i]);
+    }
+
+    if (threaded) {
+	freopen ("cpuemuth.c", "wb", stdout);
+	generate_includes (stdout);
+	generate_threaded_func ();
+    } else {
+	headerfile = fopen ("cputbl.h", "wb");
+	stblfile = fopen ("cpustbl.c", "wb");
+	freopen ("cpuemu.c", "wb", stdout);
 
-    generate_includes (stdout);
-    generate_includes (stblfile);
+	generate_includes (stdout);
+	generate_includes (stblfile);
+	generate_fuse_helpers ();
 
-    generate_func ();
+	generate_func ();
+    }
 
     free (table68k);
     return 0;
@@ -12,33 +12,44 @@
 #include "sinctable.h"
 
 #define AUDIO_DEBUG 0
-/* Queue length 256 implies minimum emulated period of 8. This should be
- * sufficient for all imaginable purposes. This must be power of two. */
+/* Queue length 256 implies minimum emulated period of 8 with the 2048 cycle
+ * BLEPs, see audio_min_period(). This must be power of two, and
+ * at least 8 for the vectorised BLEP mixers. */
 #define SINC_QUEUE_LENGTH 256
 
-typedef struct {
-    int time, output;
-} sinc_queue_t;
-
+/* State that the audio state machines and the default resampler touch on
+   every update_audio() step. One cache line per channel. */
 extern struct audio_channel_data {
-    unsigned long adk_mask;
     unsigned long evtime;
-    unsigned char dmaen, intreq2, data_written;
-    uaecptr lc, pt;
-
-    int state, wper, wlen;
+    int state;
+    int vol;
+    uae_u32 adk_mask;
     int current_sample;
     int sample_accum, sample_accum_time;
+    uaecptr lc, pt;
+    int wper, wlen;
+    uae_u16 dat, nextdat, per, len;
+    unsigned char dmaen, intreq2, data_written;
+} __attribute__ ((aligned (64))) audio_channel[4];
+
+/* Sinc resampler state, only used when it is selected */
+extern struct audio_channel_sinc {
     int output_state;
-    sinc_queue_t sinc_queue[SINC_QUEUE_LENGTH];
-    int sinc_queue_time;
-    int sinc_queue_head;
-    int vol;
-    uae_u16 dat, nextdat, per, len;    
+    int queue_time;
+    int queue_head;
+    /* BLEP queue as separate time and output arrays. Each entry is stored
+       at both i and i + SINC_QUEUE_LENGTH, so the queue can be read as one
+       contiguous run starting from queue_head. */
+    int queue_times[2 * SINC_QUEUE_LENGTH];
+    int queue_outputs[2 * SINC_QUEUE_LENGTH];
+} audio_channel_sinc[4];
 
-    /* Debug variables */
+/* DMA pointers for the AUDIO_DEBUG overrun checks */
+extern struct audio_channel_debug {
     uaecptr ptend, nextdatpt, nextdatptend, datpt, datptend;
-} audio_channel[4];
+} audio_channel_debug[4];
+
+extern int audio_schedule_dirty;
 
 extern void AUDxDAT (int nr, uae_u16 value);
 extern void AUDxVOL (int nr, uae_u16 value);
@@ -47,11 +58,14 @@ extern void AUDxLCH (int nr, uae_u16 value);
 extern void AUDxLCL (int nr, uae_u16 value);
 extern void AUDxLEN (int nr, uae_u16 value);
 
+void audio_flush_filter (void);
 void audio_reset (void);
 void audio_set_filter(int filter_type, int filter_force);
+void audio_set_period_clamp(int clamp);
 void audio_set_rate (int rate);
 void audio_set_resampler(char *name);
 void audio_use_text_scope(void);
 void update_audio (void);
+void audio_schedule (void);
 
 #endif
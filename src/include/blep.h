@@ -0,0 +1,17 @@
+#ifndef _UADE_BLEP_H_
+#define _UADE_BLEP_H_
+
+/*
+ * Sums winsinc[now - times[k]] * outputs[k] over the BLEP queue. The queue
+ * is read from index 0 until SINC_QUEUE_LENGTH entries or the first entry
+ * with age >= SINC_QUEUE_MAX_AGE. Entries are ordered from newest to
+ * oldest, so every entry after that one is older still.
+ */
+typedef int (*blep_sum_func) (const int *winsinc, const int *times,
+			      const int *outputs, int now);
+
+extern blep_sum_func blep_sum;
+
+void blep_init (void);
+
+#endif
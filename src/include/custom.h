@@ -51,6 +51,11 @@ static inline int dmaen (unsigned int dmamask)
 #define SPCFLAG_BLTNASTY 512
 #define SPCFLAG_EXEC 1024
 #define SPCFLAG_MODE_CHANGE 8192
+/* A custom register that only changes at events was read */
+#define SPCFLAG_POLL 16384
+
+/* Reads of registers whose value depends on the current cycle */
+extern uae_u32 unstable_reads;
 
 extern int dskdmaen;
 extern uae_u16 adkcon;
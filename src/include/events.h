@@ -26,56 +26,30 @@ struct ev
 enum {
     ev_hsync, ev_copper, ev_cia,
     ev_blitter, ev_diskblk, ev_diskindex,
+    ev_audio0, ev_audio1, ev_audio2, ev_audio3,
     ev_max
 };
 
 extern struct ev eventtab[ev_max];
 
-static void events_schedule (void)
-{
-  unsigned long int mintime = ~0L;
-  unsigned long int eventtime;
-  /* HSYNC */
-  if(eventtab[ev_hsync].active) {
-    eventtime = eventtab[ev_hsync].evtime - cycles;
-    if (eventtime < mintime) mintime = eventtime;
-  }
-  /* AUDIO */
-#if 0
-  if(eventtab[ev_audio].active) {
-    eventtime = eventtab[ev_audio].evtime - cycles;
-    if (eventtime < mintime) mintime = eventtime;
-  }
-#endif
-  /* CIA */
-  if(eventtab[ev_cia].active) {
-    eventtime = eventtab[ev_cia].evtime - cycles;
-    if (eventtime < mintime) mintime = eventtime;
-  }
-  nextevent = cycles + mintime;
-}
-
+/* The active events are kept in a small binary heap ordered by the time
+ * left until evtime (ties fire in eventtab order). events_schedule()
+ * rebuilds it after eventtab has been changed directly, event_reschedule()
+ * moves a single event. Both update nextevent. */
+extern void events_schedule (void);
+extern void event_reschedule (int ev);
+extern void events_fire (void);
+
+/* Jump from event to event instead of counting single cycles. An event
+ * that was scheduled for the current cycle (distance 0) is not fired,
+ * exactly like in the old cycle by cycle loop. */
 static void do_cycles_slow (unsigned long cycles_to_add) {
-  if ((nextevent - cycles) <= cycles_to_add) {
-    for (; cycles_to_add != 0; cycles_to_add--) {
-      if (++cycles == nextevent) {
-	/* HSYNC */
-	if(eventtab[ev_hsync].active && eventtab[ev_hsync].evtime == cycles) {
-	  (*eventtab[ev_hsync].handler)();
-	}
-	/* AUDIO */
-#if 0
-	if(eventtab[ev_audio].active && eventtab[ev_audio].evtime == cycles) {
-	  (*eventtab[ev_audio].handler)();
-	}
-#endif
-	/* CIA */
-	if(eventtab[ev_cia].active && eventtab[ev_cia].evtime == cycles) {
-	  (*eventtab[ev_cia].handler)();
-	}
-	events_schedule();
-      }
-    }
+  unsigned long int dist;
+
+  while ((dist = nextevent - cycles) != 0 && dist <= cycles_to_add) {
+    cycles_to_add -= dist;
+    cycles = nextevent;
+    events_fire ();
   }
   cycles += cycles_to_add;
 }
@@ -14,6 +14,8 @@ extern int sound_available;
 extern int setup_sound (void);
 
 extern void set_sound_freq (int x);
+extern void set_sound_format (int format);
+extern void set_sound_separate_voices (int separate);
 extern void init_sound (void);
 extern void flush_sound (void);
 extern void close_sound (void);
@@ -0,0 +1,25 @@
+ /*
+  * UADE
+  *
+  * x86-64 translator for predecoded 68k blocks (cpu_jit option in uaerc)
+  */
+
+#if defined(__x86_64__) && defined(__unix__)
+#define HAVE_JIT 1
+#endif
+
+/* A translated block. Returns non-zero if the CPU loop must stop. */
+typedef int jit_func (void);
+
+/* Returns 0 if the translator can not be used on this host */
+extern int jit_init (void);
+extern void jit_reset (void);
+extern void jit_report (void);
+
+/* Returns NULL when the code buffer is full. Call jit_reset() and
+ * invalidate all blocks in that case. */
+extern jit_func *jit_translate (const struct predecode_insn *insn, int n);
+
+/* Called from translated code with deferred cycles that do not reach the
+ * next event and the cycles of an instruction that may (newcpu.c) */
+extern int jit_cycles (unsigned long pending, int cycles);
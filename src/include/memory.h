@@ -6,15 +6,6 @@
   * Copyright 1995 Bernd Schmidt
   */
 
-/* Enabling this adds one additional native memory reference per 68k memory
- * access, but saves one shift (on the x86). Enabling this is probably
- * better for the cache. My favourite benchmark (PP2) doesn't show a
- * difference, so I leave this enabled. */
-
-#if 1 || defined SAVE_MEMORY
-#define SAVE_MEMORY_BANKS
-#endif
-
 #ifndef REGPARAM
 #define REGPARAM
 #endif
@@ -27,6 +18,16 @@ typedef int (*check_func)(uaecptr, uae_u32) REGPARAM;
 extern char *address_space, *good_address_map;
 extern uae_u8 *chipmemory;
 
+/* Chip memory write tracking for the predecoded instruction cache in
+ * newcpu.c. A page is marked in chipmem_codepages when it holds a
+ * predecoded opcode. Writing to a marked page unmarks it and stores a new
+ * chipmem_codegen value into chipmem_pagegen. */
+#define CHIPMEM_PAGE_SHIFT 6
+extern uae_u8 *chipmem_codepages;
+extern uae_u32 *chipmem_pagegen;
+extern uae_u32 chipmem_codegen;
+extern void chipmem_code_written (uaecptr addr, int size);
+
 extern uae_u32 allocated_chipmem;
 extern uae_u32 allocated_fastmem;
 extern uae_u32 allocated_bogomem;
@@ -36,6 +37,7 @@ extern uae_u32 allocated_a3000mem;
 
 #undef DIRECT_MEMFUNCS_SUCCESSFUL
 #include "machdep/maccess.h"
+#include <uade/compilersupport.h>
 
 #ifndef CAN_MAP_MEMORY
 #undef USE_COMPILER
@@ -97,17 +99,26 @@ extern int address_space_24;
 extern int default_check(uaecptr addr, uae_u32 size) REGPARAM;
 extern uae_u8 *default_xlate(uaecptr addr) REGPARAM;
 
-#define bankindex(addr) (((uaecptr)(addr)) >> 16)
+/* Memory banks of 64 KB. Everything UADE maps is in the low 16 MB, so the
+ * table only has the 256 banks of a 24 bit address space. With 24 bit
+ * addressing (cpu_type 68000, 68010 and 68ec020) mem_bank_highmask is 0
+ * and the upper address byte is ignored like on the real CPU. With 32 bit
+ * addressing it is 0xff000000, and an address above 16 MB is looked up in
+ * the few banks that map_banks() placed there, or ends in the dummy bank. */
+#define bankindex(addr) ((((uaecptr)(addr)) >> 16) & 0xff)
 
-#ifdef SAVE_MEMORY_BANKS
-extern addrbank *mem_banks[65536];
-#define get_mem_bank(addr) (*mem_banks[bankindex(addr)])
-#define put_mem_bank(addr, b) (mem_banks[bankindex(addr)] = (b))
-#else
-extern addrbank mem_banks[65536];
-#define get_mem_bank(addr) (mem_banks[bankindex(addr)])
-#define put_mem_bank(addr, b) (mem_banks[bankindex(addr)] = *(b))
-#endif
+extern addrbank *mem_banks[256];
+extern uaecptr mem_bank_highmask;
+extern addrbank *get_mem_bank_high (uaecptr addr);
+
+static inline addrbank *get_mem_bank_ptr (uaecptr addr)
+{
+    if (unlikely (addr & mem_bank_highmask))
+	return get_mem_bank_high (addr);
+    return mem_banks[bankindex (addr)];
+}
+
+#define get_mem_bank(addr) (*get_mem_bank_ptr (addr))
 
 extern void memory_init(void);
 extern void map_banks(addrbank *bank, int first, int count);
@@ -145,28 +156,81 @@ extern void byteput(uaecptr addr, uae_u32 b);
 
 #endif
 
+#ifdef UADE_FLAT_CHIPMEM
+/* Flat chip memory access (configure --with-flat-chipmem). An access that
+ * falls completely into chip memory reads or writes chipmemory directly
+ * instead of calling the bank function. Everything else, including the
+ * chip memory mirrors and custom/CIA registers, goes through mem_banks.
+ * In UADE chip memory is never overlaid by a ROM. */
+#define chipmem_flat(addr, size) ((addr) <= allocated_chipmem - (size))
+#endif
+
 static inline uae_u32 get_long(uaecptr addr)
 {
+#ifdef UADE_FLAT_CHIPMEM
+    if (chipmem_flat (addr, 4))
+	return do_get_mem_long ((uae_u32 *)(chipmemory + addr));
+#endif
     return longget_1(addr);
 }
 static inline uae_u32 get_word(uaecptr addr)
 {
+#ifdef UADE_FLAT_CHIPMEM
+    if (chipmem_flat (addr, 2))
+	return do_get_mem_word ((uae_u16 *)(chipmemory + addr));
+#endif
     return wordget_1(addr);
 }
 static inline uae_u32 get_byte(uaecptr addr)
 {
+#ifdef UADE_FLAT_CHIPMEM
+    if (chipmem_flat (addr, 1))
+	return chipmemory[addr];
+#endif
     return byteget_1(addr);
 }
+/* Counts CPU writes for the idle loop detection in newcpu.c */
+extern uae_u32 mem_writes;
+
 static inline void put_long(uaecptr addr, uae_u32 l)
 {
+    mem_writes++;
+#ifdef UADE_FLAT_CHIPMEM
+    if (chipmem_flat (addr, 4)) {
+	do_put_mem_long ((uae_u32 *)(chipmemory + addr), l);
+	if (chipmem_codepages[addr >> CHIPMEM_PAGE_SHIFT]
+	    | chipmem_codepages[(addr + 3) >> CHIPMEM_PAGE_SHIFT])
+	    chipmem_code_written (addr, 4);
+	return;
+    }
+#endif
     longput_1(addr, l);
 }
 static inline void put_word(uaecptr addr, uae_u32 w)
 {
+    mem_writes++;
+#ifdef UADE_FLAT_CHIPMEM
+    if (chipmem_flat (addr, 2)) {
+	do_put_mem_word ((uae_u16 *)(chipmemory + addr), w);
+	if (chipmem_codepages[addr >> CHIPMEM_PAGE_SHIFT]
+	    | chipmem_codepages[(addr + 1) >> CHIPMEM_PAGE_SHIFT])
+	    chipmem_code_written (addr, 2);
+	return;
+    }
+#endif
     wordput_1(addr, w);
 }
 static inline void put_byte(uaecptr addr, uae_u32 b)
 {
+    mem_writes++;
+#ifdef UADE_FLAT_CHIPMEM
+    if (chipmem_flat (addr, 1)) {
+	chipmemory[addr] = b;
+	if (chipmem_codepages[addr >> CHIPMEM_PAGE_SHIFT])
+	    chipmem_code_written (addr, 1);
+	return;
+    }
+#endif
     byteput_1(addr, b);
 }
 
@@ -57,6 +57,34 @@ struct cputbl {
 
 extern unsigned long op_illg (uae_u32) REGPARAM;
 
+/* One instruction of a predecoded block (newcpu.c). cycles is the value
+ * the handler returned when the block was recorded. */
+struct predecode_insn {
+    uae_u8 *pc_p;
+    cpuop_func *handler;
+    uae_u32 opcode;
+    int cycles;
+};
+
+#ifdef UADE_THREADED_CPU
+/* Label table entry of a threaded runner generated by "gencpu --threaded" */
+struct cputhr {
+    void *label;
+    uae_u16 opcode;
+};
+
+extern void build_cputhrtbl (void **table, const struct cputhr *tbl,
+			     const uae_u16 *idx, void *illg);
+
+extern void m68k_run_threaded_0 (void);
+extern void m68k_run_threaded_1 (void);
+extern void m68k_run_threaded_2 (void);
+extern void m68k_run_threaded_3 (void);
+extern void m68k_run_threaded_4 (void);
+#endif
+
+extern unsigned long cycles_mask, cycles_val;
+
 typedef char flagtype;
 
 extern struct regstruct
@@ -236,6 +264,8 @@ extern void m68k_movec2 (int, uae_u32 *);
 extern void m68k_divl (uae_u32, uae_u32, uae_u16, uaecptr);
 extern void m68k_mull (uae_u32, uae_u32, uae_u16);
 extern void init_m68k (void);
+extern void predecode_flush (void);
+extern void predecode_report (void);
 extern void m68k_go (void);
 extern void m68k_dumpstate (uaecptr *);
 extern void m68k_disasm (uaecptr, uaecptr *, int);
@@ -271,5 +301,23 @@ extern struct cputbl op_smalltbl_3[];
 /* 68000 slow but compatible.  */
 extern struct cputbl op_smalltbl_4[];
 
+/* Row of op_smalltbl_N for each opcode, generated by gencpu */
+extern const uae_u16 op_functbl_idx_0[65536];
+extern const uae_u16 op_functbl_idx_1[65536];
+extern const uae_u16 op_functbl_idx_2[65536];
+extern const uae_u16 op_functbl_idx_3[65536];
+extern const uae_u16 op_functbl_idx_4[65536];
+
+/* Superinstructions generated from a profile (gencpu --profile) */
+extern struct cputbl op_fusetbl_0[];
+extern struct cputbl op_fusetbl_1[];
+extern struct cputbl op_fusetbl_2[];
+extern struct cputbl op_fusetbl_3[];
+extern struct cputbl op_fusetbl_4[];
+
+extern int m68k_profile;
+extern void m68k_profile_start (void);
+extern void m68k_profile_send (void);
+
 extern cpuop_func *cpufunctbl[65536];
 
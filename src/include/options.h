@@ -85,6 +85,8 @@ struct uae_prefs {
     int m68k_speed;
     int cpu_level;
     int cpu_compatible;
+    int cpu_predecode;
+    int cpu_jit;
     int address_space_24;
 
     uae_u32 z3fastmem_size;
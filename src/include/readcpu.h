@@ -92,6 +92,9 @@ extern struct instr {
     unsigned int unused2:5;
 } *table68k;
 
+/* table68k after do_merges(), generated by gencpu */
+extern const struct instr table68k_data[65536];
+
 extern void read_table68k (void);
 extern void do_merges (void);
 extern int get_no_mismatches (void);
@@ -27,9 +27,11 @@ void uadecore_set_automatic_song_end(int song_end_possible);
 void uadecore_set_ntsc(int usentsc);
 void uadecore_song_end(char *reason, int kill_it);
 void uadecore_swap_buffer_bytes(void *data, int bytes);
+void uadecore_swap_buffer_longs(void *data, int bytes);
 
 extern int uadecore_audio_output;
 extern int uadecore_audio_skip;
+extern int uadecore_block_size;
 extern int uadecore_debug;
 extern int uadecore_local_sound;
 extern int uadecore_read_size;
@@ -0,0 +1,771 @@
+ /*
+  * UADE
+  *
+  * x86-64 translator for predecoded 68k blocks (cpu_jit option in uaerc)
+  *
+  * Hot blocks of the predecode cache in newcpu.c are turned into host code.
+  * The register forms of MOVE, MOVEA, ADD, SUB, CMP and their address and
+  * quick variants, TST, CLR, CMPI, LEA, Bcc and DBcc, which players run in
+  * their inner loops, are translated to native x86-64 code. Everything
+  * else becomes a direct call to the generated handler of the interpreter.
+  *
+  * Cycles are accounted once per block. The cycles of native instructions
+  * are summed in a register and added to the cycle counter only before
+  * the next handler call, because handlers may read it, and when the block
+  * is left. This is done only while the sum can not reach the next event
+  * and no special flags are set. Otherwise the instruction goes through
+  * jit_cycles(), which feeds do_cycles() and handles special flags exactly
+  * like the interpreter loop, so output is identical to the interpreter.
+  *
+  * Like the interpreter loop for predecoded blocks, the translated code
+  * leaves the block when regs.pc_p does not match the next recorded
+  * instruction (taken branch, exception) or when code was written.
+  *
+  * The code buffer is never writable and executable at the same time. The
+  * pages of a block are writable while it is translated.
+  */
+
+#include "sysconfig.h"
+#include "sysdeps.h"
+
+#include "options.h"
+#include "events.h"
+#include "memory.h"
+#include "custom.h"
+#include "readcpu.h"
+#include "newcpu.h"
+#include "jit.h"
+#include "uadectl.h"
+
+#ifdef HAVE_JIT
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define JIT_CODE_SIZE (1024 * 1024)
+/* Enough for any block of PREDECODE_BLOCK_LEN instructions */
+#define JIT_MAX_BLOCK_SIZE 8192
+#define JIT_MAX_FIXUPS 64
+
+#define REG_DISP(n) ((uae_u32) (offsetof (struct regstruct, regs) + 4 * (n)))
+#define PC_P_DISP ((uae_u32) offsetof (struct regstruct, pc_p))
+#define SPCFLAGS_DISP ((uae_u32) offsetof (struct regstruct, spcflags))
+
+/* x86 condition codes for jcc */
+#define CC_B 0x2
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_BE 0x6
+#define CC_A 0x7
+
+/* x86 ALU operations, as the reg field of opcodes 0x80 and 0x81 */
+#define ALU_ADD 0
+#define ALU_SUB 5
+#define ALU_CMP 7
+
+static uae_u8 *jit_code;
+static uae_u8 *jit_ptr;
+static long jit_pagesize;
+
+/* Positions of rel32 jumps to the two block exits */
+static uae_u8 *fixup_exit0[JIT_MAX_FIXUPS];
+static uae_u8 *fixup_exit1[JIT_MAX_FIXUPS];
+static int nfixup_exit0, nfixup_exit1;
+
+static unsigned long jit_blocks, jit_native, jit_calls;
+
+static inline void emit1 (uae_u8 b)
+{
+    *jit_ptr++ = b;
+}
+
+static inline void emit2 (uae_u16 v)
+{
+    memcpy (jit_ptr, &v, 2);
+    jit_ptr += 2;
+}
+
+static inline void emit4 (uae_u32 v)
+{
+    memcpy (jit_ptr, &v, 4);
+    jit_ptr += 4;
+}
+
+static inline void emit8 (uae_u64 v)
+{
+    memcpy (jit_ptr, &v, 8);
+    jit_ptr += 8;
+}
+
+/* mov rax, imm64 */
+static void emit_mov_rax_imm64 (const void *p)
+{
+    emit1 (0x48); emit1 (0xb8);
+    emit8 ((uae_u64) (uintptr_t) p);
+}
+
+/* mov rcx, imm64 */
+static void emit_mov_rcx_imm64 (const void *p)
+{
+    emit1 (0x48); emit1 (0xb9);
+    emit8 ((uae_u64) (uintptr_t) p);
+}
+
+/* mov rax, f; call rax */
+static void emit_call (const void *f)
+{
+    emit_mov_rax_imm64 (f);
+    emit1 (0xff); emit1 (0xd0);
+}
+
+/* jcc rel32. Returns the position of the displacement for emit_label(). */
+static uae_u8 *emit_jcc (int cond)
+{
+    emit1 (0x0f); emit1 (0x80 | cond);
+    emit4 (0);
+    return jit_ptr - 4;
+}
+
+/* jmp rel32 */
+static uae_u8 *emit_jmp (void)
+{
+    emit1 (0xe9);
+    emit4 (0);
+    return jit_ptr - 4;
+}
+
+static void patch_rel32 (uae_u8 *fixup, uae_u8 *target)
+{
+    uae_u32 rel = target - (fixup + 4);
+    memcpy (fixup, &rel, 4);
+}
+
+/* Point a jump from emit_jcc() or emit_jmp() at the current position */
+static void emit_label (uae_u8 *fixup)
+{
+    patch_rel32 (fixup, jit_ptr);
+}
+
+/* jcc rel32 to exit 0 or exit 1 */
+static void emit_jcc_exit (int cond, int exitcode)
+{
+    uae_u8 *p = emit_jcc (cond);
+
+    if (exitcode) {
+	assert (nfixup_exit1 < JIT_MAX_FIXUPS);
+	fixup_exit1[nfixup_exit1++] = p;
+    } else {
+	assert (nfixup_exit0 < JIT_MAX_FIXUPS);
+	fixup_exit0[nfixup_exit0++] = p;
+    }
+}
+
+/* mov eax, [rbx + m68k register n] */
+static void emit_load_reg (int n)
+{
+    emit1 (0x8b); emit1 (0x83);
+    emit4 (REG_DISP (n));
+}
+
+/* movsx eax, word [rbx + m68k register n] */
+static void emit_load_reg_word (int n)
+{
+    emit1 (0x0f); emit1 (0xbf); emit1 (0x83);
+    emit4 (REG_DISP (n));
+}
+
+/* mov [rbx + m68k register n], al/ax/eax */
+static void emit_store_reg (int size, int n)
+{
+    if (size == sz_byte) {
+	emit1 (0x88);
+    } else {
+	if (size == sz_word)
+	    emit1 (0x66);
+	emit1 (0x89);
+    }
+    emit1 (0x83);
+    emit4 (REG_DISP (n));
+}
+
+/* add/sub/cmp [rbx + m68k register n], al/ax/eax */
+static void emit_alu_reg (int alu, int size, int n)
+{
+    if (size == sz_word)
+	emit1 (0x66);
+    emit1 ((alu << 3) | (size == sz_byte ? 0 : 1));
+    emit1 (0x83);
+    emit4 (REG_DISP (n));
+}
+
+/* add/sub/cmp [rbx + m68k register n], imm */
+static void emit_alu_imm (int alu, int size, int n, uae_u32 imm)
+{
+    if (size == sz_word)
+	emit1 (0x66);
+    emit1 (size == sz_byte ? 0x80 : 0x81);
+    emit1 (0x83 | (alu << 3));
+    emit4 (REG_DISP (n));
+    if (size == sz_byte)
+	emit1 (imm);
+    else if (size == sz_word)
+	emit2 (imm);
+    else
+	emit4 (imm);
+}
+
+/* add qword [rbx + pc_p], len */
+static void emit_incpc (uae_s32 len)
+{
+    emit1 (0x48);
+    if (len >= -128 && len < 128) {
+	emit1 (0x83); emit1 (0x83);
+	emit4 (PC_P_DISP);
+	emit1 (len);
+    } else {
+	emit1 (0x81); emit1 (0x83);
+	emit4 (PC_P_DISP);
+	emit4 (len);
+    }
+}
+
+/* CLEAR_CZNV also drops pending lazy flags */
+static void emit_clear_lazy_flags (void)
+{
+#ifdef UADE_LAZY_FLAGS
+    emit_mov_rax_imm64 (&lazyflags.op);
+    emit1 (0xc7); emit1 (0x00);			/* mov dword [rax], 0 */
+    emit4 (0);
+#endif
+}
+
+/* regflags.cznv uses the bit positions of the x86 flags register, so the
+ * flags of the last x86 operation can be stored directly. ADD also copies
+ * them to X like COPY_CARRY. */
+static void emit_store_flags (int copy_carry)
+{
+    emit1 (0x9c);				/* pushfq */
+    emit1 (0x59);				/* pop rcx */
+    emit1 (0x81); emit1 (0xe1);			/* and ecx, 0x8c1 */
+    emit4 (0x8c1);
+    emit_mov_rax_imm64 (&regflags);
+    emit1 (0x89); emit1 (0x08);			/* mov [rax], ecx */
+    if (copy_carry) {
+	emit1 (0x89); emit1 (0x48);		/* mov [rax + x], ecx */
+	emit1 (offsetof (struct flag_struct, x));
+    }
+    emit_clear_lazy_flags ();
+}
+
+/* Set regflags.cznv to flags known at translation time */
+static void emit_set_flags (uae_u32 cznv)
+{
+    emit_clear_lazy_flags ();
+    emit_mov_rax_imm64 (&regflags.cznv);
+    emit1 (0xc7); emit1 (0x00);			/* mov dword [rax], imm32 */
+    emit4 (cznv);
+}
+
+/* Set the x86 zero flag from condition code cc (2 to 15) like cctrue()
+ * does. Returns the x86 condition that holds when cc is true. */
+static int emit_cc (int cc)
+{
+    uae_u32 mask;
+
+#ifdef UADE_LAZY_FLAGS
+    emit_mov_rax_imm64 (&lazyflags.op);
+    emit1 (0x83); emit1 (0x38); emit1 (0);	/* cmp dword [rax], 0 */
+    emit1 (0x74); emit1 (12);			/* je over the call */
+    emit_call ((void *) lazy_flags_eval);
+#endif
+    emit_mov_rax_imm64 (&regflags.cznv);
+    emit1 (0x8b); emit1 (0x08);			/* mov ecx, [rax] */
+
+    switch (cc >> 1) {
+    case 1: mask = 0x41; break;			/* HI, LS */
+    case 2: mask = 0x01; break;			/* CC, CS */
+    case 3: mask = 0x40; break;			/* NE, EQ */
+    case 4: mask = 0x800; break;		/* VC, VS */
+    case 5: mask = 0x80; break;			/* PL, MI */
+    default:
+	/* GE, LT, GT, LE compare N shifted to V with V */
+	if (cc >= 14) {
+	    emit1 (0x81); emit1 (0xe1);		/* and ecx, 0x8c0 */
+	    emit4 (0x8c0);
+	}
+	emit1 (0x89); emit1 (0xca);		/* mov edx, ecx */
+	emit1 (0xc1); emit1 (0xe2); emit1 (4);	/* shl edx, 4 */
+	emit1 (0x31); emit1 (0xca);		/* xor edx, ecx */
+	emit1 (0xf7); emit1 (0xc2);		/* test edx, mask */
+	emit4 (cc >= 14 ? 0x840 : 0x800);
+	return (cc & 1) ? CC_NE : CC_E;
+    }
+    emit1 (0xf7); emit1 (0xc1);			/* test ecx, mask */
+    emit4 (mask);
+    return (cc & 1) ? CC_NE : CC_E;
+}
+
+/* Effective cycles of an instruction, computed like predecode_cycles()
+ * does. newcpu.c throws translated code away when the inputs change. */
+static uae_u32 jit_effective_cycles (int cycles)
+{
+    if (uadecore_time_critical)
+	cycles = 1;
+    return (cycles & cycles_mask) | cycles_val;
+}
+
+/* r15 = nextevent - cycles, the number of cycles that can be added before
+ * an event must be fired. Uses rcx. */
+static void emit_load_budget (void)
+{
+    emit_mov_rcx_imm64 (&nextevent);
+    emit1 (0x4c); emit1 (0x8b); emit1 (0x39);	/* mov r15, [rcx] */
+    emit_mov_rcx_imm64 (&cycles);
+    emit1 (0x4c); emit1 (0x2b); emit1 (0x39);	/* sub r15, [rcx] */
+}
+
+/* Like emit_load_budget(), but no cycles may be deferred while special
+ * flags are set */
+static void emit_budget (void)
+{
+    emit_load_budget ();
+    emit1 (0x83); emit1 (0xbb);			/* cmp dword [rbx + spcflags], 0 */
+    emit4 (SPCFLAGS_DISP);
+    emit1 (0);
+    emit1 (0x74); emit1 (3);			/* je over the xor */
+    emit1 (0x45); emit1 (0x31); emit1 (0xff);	/* xor r15d, r15d */
+}
+
+/* Add the deferred cycles in r14 to the cycle counter */
+static void emit_flush_cycles (void)
+{
+    emit_mov_rcx_imm64 (&cycles);
+    emit1 (0x4c); emit1 (0x01); emit1 (0x31);	/* add [rcx], r14 */
+    emit1 (0x45); emit1 (0x31); emit1 (0xf6);	/* xor r14d, r14d */
+}
+
+/* Leave the block if the translated code was written */
+static void emit_codegen_check (void)
+{
+    emit1 (0x45); emit1 (0x3b); emit1 (0x65); emit1 (0x00);	/* cmp r12d, [r13] */
+    emit_jcc_exit (CC_NE, 0);
+}
+
+/* Feed the deferred cycles and the cycles of the current instruction in
+ * esi to jit_cycles(), which may fire events and handle special flags */
+static void emit_exact_cycles (void)
+{
+    emit1 (0x4c); emit1 (0x89); emit1 (0xf7);	/* mov rdi, r14 */
+    emit_call ((void *) jit_cycles);
+    emit1 (0x45); emit1 (0x31); emit1 (0xf6);	/* xor r14d, r14d */
+    emit1 (0x85); emit1 (0xc0);			/* test eax, eax */
+    emit_jcc_exit (CC_NE, 1);
+    emit_budget ();
+}
+
+/* Cycles of a native instruction: defer them if they fit in the budget */
+static void emit_native_cycles (const struct predecode_insn *in)
+{
+    uae_u32 c = jit_effective_cycles (in->cycles);
+    uae_u8 *fits;
+
+    emit1 (0x49); emit1 (0x81); emit1 (0xc6);	/* add r14, c */
+    emit4 (c);
+    emit1 (0x49); emit1 (0x81); emit1 (0xef);	/* sub r15, c */
+    emit4 (c);
+    fits = emit_jcc (CC_A);
+    emit1 (0x49); emit1 (0x81); emit1 (0xee);	/* sub r14, c */
+    emit4 (c);
+    emit1 (0xbe);				/* mov esi, cycles */
+    emit4 (in->cycles);
+    emit_exact_cycles ();
+    /* Events may have written chip memory */
+    emit_codegen_check ();
+    emit_label (fits);
+}
+
+/* Call the handler of the interpreter. The handler sees the same cycle
+ * counter as in the interpreter, and its cycles are deferred if nothing
+ * needs attention. */
+static void emit_handler_call (const struct predecode_insn *in)
+{
+    uae_u8 *exact[3], *done;
+    int i;
+
+    emit_flush_cycles ();
+    emit1 (0xbf);				/* mov edi, opcode */
+    emit4 (in->opcode);
+    emit_call ((void *) in->handler);
+    emit1 (0x89); emit1 (0xc6);			/* mov esi, eax */
+
+    emit1 (0x83); emit1 (0xbb);			/* cmp dword [rbx + spcflags], 0 */
+    emit4 (SPCFLAGS_DISP);
+    emit1 (0);
+    exact[0] = emit_jcc (CC_NE);
+    emit_mov_rax_imm64 (&uadecore_reboot);
+    emit1 (0x83); emit1 (0x38); emit1 (0);	/* cmp dword [rax], 0 */
+    exact[1] = emit_jcc (CC_NE);
+
+    emit1 (0x89); emit1 (0xf0);			/* mov eax, esi */
+    if (uadecore_time_critical) {
+	emit1 (0xb8); emit4 (1);		/* mov eax, 1 */
+    } else {
+	if ((cycles_mask & 0xffffffff) != 0xffffffff) {
+	    emit1 (0x25); emit4 (cycles_mask);	/* and eax, cycles_mask */
+	}
+	if (cycles_val) {
+	    emit1 (0x0d); emit4 (cycles_val);	/* or eax, cycles_val */
+	}
+    }
+    emit_load_budget ();
+    emit1 (0x49); emit1 (0x29); emit1 (0xc7);	/* sub r15, rax */
+    exact[2] = emit_jcc (CC_BE);
+    emit1 (0x49); emit1 (0x89); emit1 (0xc6);	/* mov r14, rax */
+    done = emit_jmp ();
+
+    for (i = 0; i < 3; i++)
+	emit_label (exact[i]);
+    emit_exact_cycles ();
+    emit_label (done);
+
+    /* The block may have modified itself */
+    emit_codegen_check ();
+}
+
+/* Extension words are only built into the code when they are on the page
+ * of the opcode, so that writing them invalidates the block */
+static int ext_on_opcode_page (const struct predecode_insn *in, int len)
+{
+    return ((in->pc_p + len - 1 - chipmemory) >> CHIPMEM_PAGE_SHIFT)
+	== ((in->pc_p - chipmemory) >> CHIPMEM_PAGE_SHIFT);
+}
+
+static inline uae_s32 ext_word (const struct predecode_insn *in, int offset)
+{
+    return (uae_s16) do_get_mem_word ((uae_u16 *) (in->pc_p + offset));
+}
+
+/* Size field in bits 6 and 7 of most instructions */
+static const int size_bits[4] = { sz_byte, sz_word, sz_long, -1 };
+/* Size field of MOVE */
+static const int move_size_bits[4] = { -1, sz_byte, sz_long, sz_word };
+
+/* Translate one instruction to native code. Returns 0 if the instruction
+ * has no native translation. */
+static int emit_native (const struct predecode_insn *in)
+{
+    uae_u32 opcode = in->opcode;
+    int src = opcode & 7;
+    int smode = (opcode >> 3) & 7;
+    int dst = (opcode >> 9) & 7;
+    int cc = (opcode >> 8) & 15;
+    int size = size_bits[(opcode >> 6) & 3];
+    uae_u8 *taken, *skip, *out;
+    uae_s32 v;
+
+    /* The compatible 68000 handlers also maintain the prefetch word */
+    if (currprefs.cpu_level == 0 && currprefs.cpu_compatible)
+	return 0;
+
+    if (opcode == 0x4e71) {
+	/* NOP */
+	emit_incpc (2);
+    } else if ((opcode & 0xf100) == 0x7000) {
+	/* MOVEQ #imm,Dn: the flags are known at translation time */
+	v = (uae_s8) (opcode & 255);
+	emit1 (0xc7); emit1 (0x83);		/* mov dword [rbx + Dn], imm32 */
+	emit4 (REG_DISP (dst));
+	emit4 (v);
+	emit_set_flags ((v == 0 ? 0x40 : 0) | (v < 0 ? 0x80 : 0));
+	emit_incpc (2);
+    } else if ((opcode & 0xc000) == 0 && move_size_bits[(opcode >> 12) & 3] >= 0
+	       && (smode == 0 || (smode == 1 && (opcode & 0x3000) != 0x1000))
+	       && ((opcode >> 6) & 7) <= 1) {
+	/* MOVE Rn,Dm and MOVEA Rn,Am */
+	size = move_size_bits[(opcode >> 12) & 3];
+	if (((opcode >> 6) & 7) == 1) {
+	    if (size == sz_byte)
+		return 0;
+	    if (size == sz_word)
+		emit_load_reg_word (opcode & 15);
+	    else
+		emit_load_reg (opcode & 15);
+	    emit_store_reg (sz_long, 8 + dst);
+	} else {
+	    emit_load_reg (opcode & 15);
+	    emit_store_reg (size, dst);
+	    if (size == sz_word)
+		emit1 (0x66);
+	    emit1 (size == sz_byte ? 0x84 : 0x85);	/* test eax, eax */
+	    emit1 (0xc0);
+	    emit_store_flags (0);
+	}
+	emit_incpc (2);
+    } else if (((opcode & 0xf000) == 0xd000 || (opcode & 0xf000) == 0x9000
+		|| (opcode & 0xf000) == 0xb000)
+	       && (smode == 0 || (smode == 1 && size != sz_byte))) {
+	/* ADD, SUB, CMP Rn,Dm and ADDA, SUBA, CMPA Rn,Am */
+	int alu = (opcode & 0xf000) == 0xd000 ? ALU_ADD
+	    : (opcode & 0xf000) == 0x9000 ? ALU_SUB : ALU_CMP;
+	if (size < 0) {
+	    /* The address forms always work on the whole register, and
+	     * only CMPA sets flags */
+	    if (opcode & 0x0100)
+		emit_load_reg (opcode & 15);
+	    else
+		emit_load_reg_word (opcode & 15);
+	    emit_alu_reg (alu, sz_long, 8 + dst);
+	    if (alu == ALU_CMP)
+		emit_store_flags (0);
+	} else if (opcode & 0x0100) {
+	    /* Dn,<ea> forms, ADDX, SUBX, CMPM and EOR */
+	    return 0;
+	} else {
+	    emit_load_reg (opcode & 15);
+	    emit_alu_reg (alu, size, dst);
+	    emit_store_flags (alu == ALU_ADD);
+	}
+	emit_incpc (2);
+    } else if ((opcode & 0xf038) == 0x5000 && size >= 0) {
+	/* ADDQ/SUBQ #imm,Dn */
+	v = dst ? dst : 8;
+	emit_alu_imm ((opcode & 0x0100) ? ALU_SUB : ALU_ADD, size, src, v);
+	emit_store_flags (!(opcode & 0x0100));
+	emit_incpc (2);
+    } else if ((opcode & 0xf0f8) == 0x5048 || (opcode & 0xf0f8) == 0x5088) {
+	/* ADDQ/SUBQ #imm,An: word and long size work on the whole register
+	 * and do not change flags */
+	v = dst ? dst : 8;
+	emit1 (0x83);
+	emit1 ((opcode & 0x0100) ? 0xab : 0x83);	/* add/sub dword [rbx + An], imm8 */
+	emit4 (REG_DISP (8 + src));
+	emit1 (v);
+	emit_incpc (2);
+    } else if ((opcode & 0xff38) == 0x4a00 && size >= 0) {
+	/* TST Dn */
+	emit_load_reg (src);
+	if (size == sz_word)
+	    emit1 (0x66);
+	emit1 (size == sz_byte ? 0x84 : 0x85);	/* test eax, eax */
+	emit1 (0xc0);
+	emit_store_flags (0);
+	emit_incpc (2);
+    } else if ((opcode & 0xff38) == 0x4200 && size >= 0) {
+	/* CLR Dn */
+	emit1 (0x31); emit1 (0xc0);		/* xor eax, eax */
+	emit_store_reg (size, src);
+	emit_set_flags (0x40);
+	emit_incpc (2);
+    } else if ((opcode & 0xff38) == 0x0c00 && size >= 0
+	       && ext_on_opcode_page (in, size == sz_long ? 6 : 4)) {
+	/* CMPI #imm,Dn */
+	if (size == sz_long)
+	    v = do_get_mem_long ((uae_u32 *) (in->pc_p + 2));
+	else
+	    v = ext_word (in, 2);
+	emit_alu_imm (ALU_CMP, size, src, v);
+	emit_store_flags (0);
+	emit_incpc (size == sz_long ? 6 : 4);
+    } else if ((opcode & 0xf1f8) == 0x41e8 && ext_on_opcode_page (in, 4)) {
+	/* LEA d16(An),Am */
+	v = ext_word (in, 2);
+	emit_load_reg (8 + src);
+	emit1 (0x05);				/* add eax, imm32 */
+	emit4 (v);
+	emit_store_reg (sz_long, 8 + dst);
+	emit_incpc (4);
+    } else if ((opcode & 0xf000) == 0x6000 && cc != 1 && (opcode & 255) != 255
+	       && ((opcode & 255) != 0 || ext_on_opcode_page (in, 4))) {
+	/* BRA and Bcc with 8 and 16 bit displacements */
+	v = (opcode & 255) ? (uae_s8) (opcode & 255) : ext_word (in, 2);
+	if (cc == 0) {
+	    emit_incpc (v + 2);
+	} else {
+	    skip = emit_jcc (emit_cc (cc) ^ 1);
+	    emit_incpc (v + 2);
+	    out = emit_jmp ();
+	    emit_label (skip);
+	    emit_incpc ((opcode & 255) ? 2 : 4);
+	    emit_label (out);
+	}
+    } else if ((opcode & 0xf0f8) == 0x50c8 && ext_on_opcode_page (in, 4)) {
+	/* DBcc Dn */
+	v = ext_word (in, 2);
+	taken = NULL;
+	if (cc == 0) {
+	    emit_incpc (4);
+	} else {
+	    if (cc != 1)
+		taken = emit_jcc (emit_cc (cc));
+	    emit1 (0x66); emit1 (0x83); emit1 (0xab);	/* sub word [rbx + Dn], 1 */
+	    emit4 (REG_DISP (src));
+	    emit1 (1);
+	    skip = emit_jcc (CC_B);		/* the counter was 0 */
+	    emit_incpc (v + 2);
+	    out = emit_jmp ();
+	    if (taken != NULL)
+		emit_label (taken);
+	    emit_label (skip);
+	    emit_incpc (4);
+	    emit_label (out);
+	}
+    } else {
+	return 0;
+    }
+    return 1;
+}
+
+/* Change the protection of the code buffer pages from start to end */
+static int jit_protect (uae_u8 *start, uae_u8 *end, int prot)
+{
+    uae_u8 *page = jit_code + ((start - jit_code) & ~(jit_pagesize - 1));
+
+    return mprotect (page, end - page, prot);
+}
+
+int jit_init (void)
+{
+    if (jit_code != NULL)
+	return 1;
+    jit_pagesize = sysconf (_SC_PAGESIZE);
+    if (jit_pagesize <= 0)
+	return 0;
+    jit_code = mmap (NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jit_code == MAP_FAILED) {
+	jit_code = NULL;
+	return 0;
+    }
+    /* Check that the system allows executable mappings */
+    if (jit_protect (jit_code, jit_code + JIT_CODE_SIZE, PROT_READ | PROT_EXEC)) {
+	munmap (jit_code, JIT_CODE_SIZE);
+	jit_code = NULL;
+	return 0;
+    }
+    jit_ptr = jit_code;
+    return 1;
+}
+
+void jit_reset (void)
+{
+    jit_ptr = jit_code;
+}
+
+void jit_report (void)
+{
+    if (uadecore_debug)
+	fprintf (stderr, "uadecore: jit: %lu blocks, %lu native instructions, "
+		 "%lu handler calls, %lu bytes of code\n",
+		 jit_blocks, jit_native, jit_calls,
+		 (unsigned long) (jit_ptr - jit_code));
+    jit_blocks = jit_native = jit_calls = 0;
+}
+
+/* Register use in translated code:
+ *   rbx  &regs
+ *   r12d chipmem_codegen at block entry
+ *   r13  &chipmem_codegen
+ *   r14  cycles that have not been added to the cycle counter yet
+ *   r15  cycles that can still be deferred: nextevent - cycles - r14,
+ *        or 0 when special flags are set */
+jit_func *jit_translate (const struct predecode_insn *insn, int n)
+{
+    const struct predecode_insn *in;
+    uae_u8 *start = jit_ptr;
+    uae_u8 *exit0, *exit1, *out;
+    int i;
+
+    if (jit_code + JIT_CODE_SIZE - jit_ptr < JIT_MAX_BLOCK_SIZE)
+	return NULL;
+    if (jit_protect (start, start + JIT_MAX_BLOCK_SIZE, PROT_READ | PROT_WRITE)) {
+	fprintf (stderr, "uadecore: Can not write JIT code.\n");
+	exit (1);
+    }
+    nfixup_exit0 = nfixup_exit1 = 0;
+
+    /* Five pushes leave the stack aligned for calls */
+    emit1 (0x53);				/* push rbx */
+    emit1 (0x41); emit1 (0x54);			/* push r12 */
+    emit1 (0x41); emit1 (0x55);			/* push r13 */
+    emit1 (0x41); emit1 (0x56);			/* push r14 */
+    emit1 (0x41); emit1 (0x57);			/* push r15 */
+    emit1 (0x48); emit1 (0xbb);			/* mov rbx, &regs */
+    emit8 ((uae_u64) (uintptr_t) &regs);
+    emit1 (0x49); emit1 (0xbd);			/* mov r13, &chipmem_codegen */
+    emit8 ((uae_u64) (uintptr_t) &chipmem_codegen);
+    emit1 (0x45); emit1 (0x8b); emit1 (0x65); emit1 (0x00);	/* mov r12d, [r13] */
+    emit1 (0x45); emit1 (0x31); emit1 (0xf6);	/* xor r14d, r14d */
+    emit_budget ();
+
+    for (i = 0; i < n; i++) {
+	in = &insn[i];
+	if (i > 0) {
+	    /* Leave the block if the previous instruction jumped */
+	    emit_mov_rax_imm64 (in->pc_p);
+	    emit1 (0x48); emit1 (0x39); emit1 (0x83);	/* cmp [rbx + pc_p], rax */
+	    emit4 (PC_P_DISP);
+	    emit_jcc_exit (CC_NE, 0);
+	}
+
+	if (emit_native (in)) {
+	    emit_native_cycles (in);
+	    jit_native++;
+	} else {
+	    emit_handler_call (in);
+	    jit_calls++;
+	}
+    }
+
+    exit0 = jit_ptr;
+    emit1 (0x31); emit1 (0xc0);			/* xor eax, eax */
+    emit1 (0xeb); emit1 (0x05);			/* jmp out */
+    exit1 = jit_ptr;
+    emit1 (0xb8); emit4 (1);			/* mov eax, 1 */
+    out = jit_ptr;
+    emit_mov_rcx_imm64 (&cycles);
+    emit1 (0x4c); emit1 (0x01); emit1 (0x31);	/* add [rcx], r14 */
+    emit1 (0x41); emit1 (0x5f);			/* pop r15 */
+    emit1 (0x41); emit1 (0x5e);			/* pop r14 */
+    emit1 (0x41); emit1 (0x5d);			/* pop r13 */
+    emit1 (0x41); emit1 (0x5c);			/* pop r12 */
+    emit1 (0x5b);				/* pop rbx */
+    emit1 (0xc3);				/* ret */
+    assert (exit1 + 5 == out);
+    assert (jit_ptr - start <= JIT_MAX_BLOCK_SIZE);
+
+    for (i = 0; i < nfixup_exit0; i++)
+	patch_rel32 (fixup_exit0[i], exit0);
+    for (i = 0; i < nfixup_exit1; i++)
+	patch_rel32 (fixup_exit1[i], exit1);
+
+    if (jit_protect (start, start + JIT_MAX_BLOCK_SIZE, PROT_READ | PROT_EXEC)) {
+	fprintf (stderr, "uadecore: Can not make JIT code executable.\n");
+	exit (1);
+    }
+    jit_blocks++;
+    return (jit_func *) start;
+}
+
+#else /* HAVE_JIT */
+
+int jit_init (void)
+{
+    return 0;
+}
+
+void jit_reset (void)
+{
+}
+
+void jit_report (void)
+{
+}
+
+jit_func *jit_translate (const struct predecode_insn *insn, int n)
+{
+    return NULL;
+}
+
+#endif /* HAVE_JIT */
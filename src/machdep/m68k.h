@@ -11,26 +11,53 @@ struct flag_struct {
     unsigned int x;
 };
 
-#define SET_ZFLG(y) (regflags.cznv = (regflags.cznv & ~0x40) | (((y) & 1) << 6))
-#define SET_CFLG(y) (regflags.cznv = (regflags.cznv & ~1) | ((y) & 1))
-#define SET_VFLG(y) (regflags.cznv = (regflags.cznv & ~0x800) | (((y) & 1) << 11))
-#define SET_NFLG(y) (regflags.cznv = (regflags.cznv & ~0x80) | (((y) & 1) << 7))
+#ifdef UADE_LAZY_FLAGS
+/* With gencpu --lazy-flags the common ALU handlers only store their
+ * operands in lazyflags. C, Z, N and V are computed by lazy_flags_eval()
+ * when the flags are read or partially changed. X is always set directly. */
+struct lazy_flags {
+    unsigned int op;
+    uae_u32 src, dst, res;
+};
+
+#define LAZY_LOGICAL 1
+#define LAZY_ADD 2
+#define LAZY_SUB 3
+#define LAZY_CMP 4
+#define LAZY_OP(kind, size) (((kind) << 2) | (size))
+
+extern struct lazy_flags lazyflags;
+extern void lazy_flags_eval (void);
+
+#define FLUSH_FLAGS (lazyflags.op ? lazy_flags_eval () : (void) 0)
+#define CLEAR_CZNV (lazyflags.op = 0, regflags.cznv = 0)
+#else
+#define FLUSH_FLAGS ((void) 0)
+#define CLEAR_CZNV (regflags.cznv = 0)
+#endif
+
+#define SET_ZFLG(y) (FLUSH_FLAGS, regflags.cznv = (regflags.cznv & ~0x40) | (((y) & 1) << 6))
+#define SET_CFLG(y) (FLUSH_FLAGS, regflags.cznv = (regflags.cznv & ~1) | ((y) & 1))
+#define SET_VFLG(y) (FLUSH_FLAGS, regflags.cznv = (regflags.cznv & ~0x800) | (((y) & 1) << 11))
+#define SET_NFLG(y) (FLUSH_FLAGS, regflags.cznv = (regflags.cznv & ~0x80) | (((y) & 1) << 7))
 #define SET_XFLG(y) (regflags.x = (y))
 
-#define GET_ZFLG ((regflags.cznv >> 6) & 1)
-#define GET_CFLG (regflags.cznv & 1)
-#define GET_VFLG ((regflags.cznv >> 11) & 1)
-#define GET_NFLG ((regflags.cznv >> 7) & 1)
+#define GET_ZFLG (FLUSH_FLAGS, (regflags.cznv >> 6) & 1)
+#define GET_CFLG (FLUSH_FLAGS, regflags.cznv & 1)
+#define GET_VFLG (FLUSH_FLAGS, (regflags.cznv >> 11) & 1)
+#define GET_NFLG (FLUSH_FLAGS, (regflags.cznv >> 7) & 1)
 #define GET_XFLG (regflags.x & 1)
 
-#define CLEAR_CZNV (regflags.cznv = 0)
-#define COPY_CARRY (regflags.x = regflags.cznv)
+#define COPY_CARRY (FLUSH_FLAGS, regflags.x = regflags.cznv)
 
 extern struct flag_struct regflags;
 
 static inline int cctrue(int cc)
 {
-    uae_u32 cznv = regflags.cznv;
+    uae_u32 cznv;
+
+    FLUSH_FLAGS;
+    cznv = regflags.cznv;
     switch(cc){
      case 0: return 1;                       /* T */
      case 1: return 0;                       /* F */
@@ -14,6 +14,54 @@
 
 struct flag_struct regflags;
 
+#ifdef UADE_LAZY_FLAGS
+struct lazy_flags lazyflags;
+
+/* Compute C, Z, N and V of the last lazily flagged operation the same way
+ * as the eager handlers of gencpu do. */
+void lazy_flags_eval (void)
+{
+    uae_u32 src = lazyflags.src, dst = lazyflags.dst, res;
+    uae_u32 mask, sign;
+    int flgs, flgo, flgn, z, c, v;
+
+    switch (lazyflags.op & 3) {
+     case 0: mask = 0xff; break;
+     case 1: mask = 0xffff; break;
+     default: mask = 0xffffffff; break;
+    }
+    sign = (mask >> 1) + 1;
+
+    switch (lazyflags.op >> 2) {
+     case LAZY_LOGICAL:
+	res = lazyflags.res;
+	flgn = (res & sign) != 0;
+	c = v = 0;
+	break;
+     case LAZY_ADD:
+	res = dst + src;
+	flgs = (src & sign) != 0;
+	flgo = (dst & sign) != 0;
+	flgn = (res & sign) != 0;
+	v = (flgs ^ flgn) & (flgo ^ flgn);
+	c = (~dst & mask) < (src & mask);
+	break;
+     default: /* LAZY_SUB, LAZY_CMP */
+	res = dst - src;
+	flgs = (src & sign) != 0;
+	flgo = (dst & sign) != 0;
+	flgn = (res & sign) != 0;
+	v = (flgs ^ flgo) & (flgn ^ flgo);
+	c = (src & mask) > (dst & mask);
+	break;
+    }
+    z = (res & mask) == 0;
+
+    lazyflags.op = 0;
+    regflags.cznv = (v << 11) | (flgn << 7) | (z << 6) | c;
+}
+#endif
+
 int fast_memcmp(const void *foo, const void *bar, int len)
 {
     return memcmp(foo, bar, len);
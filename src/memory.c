@@ -28,11 +28,16 @@ uae_u32 allocated_gfxmem;
 uae_u32 allocated_z3fastmem;
 uae_u32 allocated_a3000mem;
 
-#ifdef SAVE_MEMORY_BANKS
-addrbank *mem_banks[65536];
-#else
-addrbank mem_banks[65536];
-#endif
+addrbank *mem_banks[256];
+uaecptr mem_bank_highmask;
+
+/* Banks above 16 MB with 32 bit addressing (see memory.h) */
+#define MAX_HIGH_BANK_RANGES 8
+static struct {
+    int start, size;
+    addrbank *bank;
+} high_banks[MAX_HIGH_BANK_RANGES];
+static int n_high_banks;
 
 #ifdef NO_INLINE_MEMORY_ACCESS
 inline uae_u32 longget (uaecptr addr)
@@ -187,6 +192,25 @@ static int REGPARAM2 mbres_check (uaecptr addr, uae_u32 size)
 
 uae_u8 *chipmemory;
 
+uae_u8 *chipmem_codepages;
+uae_u32 *chipmem_pagegen;
+uae_u32 chipmem_codegen;
+
+uae_u32 mem_writes;
+
+void chipmem_code_written (uaecptr addr, int size)
+{
+    int page = addr >> CHIPMEM_PAGE_SHIFT;
+    int last = (addr + size - 1) >> CHIPMEM_PAGE_SHIFT;
+
+    for (; page <= last; page++) {
+	if (chipmem_codepages[page]) {
+	    chipmem_codepages[page] = 0;
+	    chipmem_pagegen[page] = ++chipmem_codegen;
+	}
+    }
+}
+
 static uae_u32 chipmem_lget (uaecptr) REGPARAM;
 static uae_u32 chipmem_wget (uaecptr) REGPARAM;
 static uae_u32 chipmem_bget (uaecptr) REGPARAM;
@@ -228,6 +252,9 @@ static void REGPARAM2 chipmem_lput (uaecptr addr, uae_u32 l)
     addr &= chipmem_mask;
     m = (uae_u32 *)(chipmemory + addr);
     do_put_mem_long (m, l);
+    if (chipmem_codepages[addr >> CHIPMEM_PAGE_SHIFT]
+	| chipmem_codepages[(addr + 3) >> CHIPMEM_PAGE_SHIFT])
+	chipmem_code_written (addr, 4);
 }
 
 static void REGPARAM2 chipmem_wput (uaecptr addr, uae_u32 w)
@@ -237,6 +264,9 @@ static void REGPARAM2 chipmem_wput (uaecptr addr, uae_u32 w)
     addr &= chipmem_mask;
     m = (uae_u16 *)(chipmemory + addr);
     do_put_mem_word (m, w);
+    if (chipmem_codepages[addr >> CHIPMEM_PAGE_SHIFT]
+	| chipmem_codepages[(addr + 1) >> CHIPMEM_PAGE_SHIFT])
+	chipmem_code_written (addr, 2);
 }
 
 static void REGPARAM2 chipmem_bput (uaecptr addr, uae_u32 b)
@@ -244,6 +274,8 @@ static void REGPARAM2 chipmem_bput (uaecptr addr, uae_u32 b)
     addr -= chipmem_start & chipmem_mask;
     addr &= chipmem_mask;
     chipmemory[addr] = b;
+    if (chipmem_codepages[addr >> CHIPMEM_PAGE_SHIFT])
+	chipmem_code_written (addr, 1);
 }
 
 static int REGPARAM2 chipmem_check (uaecptr addr, uae_u32 size)
@@ -538,11 +570,27 @@ addrbank kickmem_bank = {
 char *address_space, *good_address_map;
 static int good_address_fd;
 
+addrbank *get_mem_bank_high (uaecptr addr)
+{
+    int bnr = addr >> 16;
+    int i;
+
+    /* Later mappings override earlier ones */
+    for (i = n_high_banks - 1; i >= 0; i--) {
+	if (bnr >= high_banks[i].start
+	    && bnr < high_banks[i].start + high_banks[i].size)
+	    return high_banks[i].bank;
+    }
+    return &dummy_bank;
+}
+
 static void init_mem_banks (void)
 {
     int i;
-    for (i = 0; i < 65536; i++)
-	put_mem_bank (i<<16, &dummy_bank);
+    for (i = 0; i < 256; i++)
+	mem_banks[i] = &dummy_bank;
+    n_high_banks = 0;
+    mem_bank_highmask = currprefs.address_space_24 ? 0 : 0xff000000;
 }
 
 #define MAKE_USER_PROGRAMS_BEHAVE 1
@@ -607,6 +655,15 @@ void memory_init (void)
 #endif
 
     do_put_mem_long ((uae_u32 *)(chipmemory + 4), 0);
+
+    /* One extra page for word and long writes at the end of chip memory */
+    chipmem_codepages = (uae_u8 *) calloc (1, (allocated_chipmem >> CHIPMEM_PAGE_SHIFT) + 1);
+    chipmem_pagegen = (uae_u32 *) calloc ((allocated_chipmem >> CHIPMEM_PAGE_SHIFT) + 1, sizeof (uae_u32));
+    if (! chipmem_codepages || ! chipmem_pagegen) {
+	write_log ("virtual memory exhausted (chipmem_codepages)!\n");
+	abort ();
+    }
+
     init_mem_banks ();
 
     /* Map the chipmem into all of the lower 16MB */
@@ -655,17 +712,21 @@ void memory_init (void)
 void map_banks (addrbank *bank, int start, int size)
 {
     int bnr;
-    unsigned long int hioffs = 0, endhioffs = 0x100;
 
     if (start >= 0x100) {
-	for (bnr = start; bnr < start + size; bnr++)
-	    put_mem_bank (bnr << 16, bank);
+	/* Not reachable with 24 bit addressing */
+	if (n_high_banks == MAX_HIGH_BANK_RANGES) {
+	    write_log ("Too many memory banks above 16 MB\n");
+	    abort ();
+	}
+	high_banks[n_high_banks].start = start;
+	high_banks[n_high_banks].size = size;
+	high_banks[n_high_banks].bank = bank;
+	n_high_banks++;
 	return;
     }
-    /* Some '020 Kickstarts apparently require a 24 bit address space... */
-    if (currprefs.address_space_24)
-	endhioffs = 0x10000;
-    for (hioffs = 0; hioffs < endhioffs; hioffs += 0x100)
-	for (bnr = start; bnr < start+size; bnr++)
-	    put_mem_bank ((bnr + hioffs) << 16, bank);
+    /* Some '020 Kickstarts apparently require a 24 bit address space, which
+     * get_mem_bank() handles by ignoring the upper address byte */
+    for (bnr = start; bnr < start + size && bnr < 0x100; bnr++)
+	mem_banks[bnr] = bank;
 }
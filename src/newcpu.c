@@ -7,6 +7,7 @@
   */
 
 #include <time.h>
+#include <arpa/inet.h>
 
 #include "sysconfig.h"
 #include "sysdeps.h"
@@ -20,6 +21,7 @@
 #include "newcpu.h"
 #include "debug.h"
 #include "compiler.h"
+#include "jit.h"
 
 #include "cia.h"
 
@@ -127,38 +129,62 @@ static void build_cpufunctbl (void)
 {
     int i;
     unsigned long opcode;
-    struct cputbl *tbl = (currprefs.cpu_level == 3 ? op_smalltbl_0
-			  : currprefs.cpu_level == 2 ? op_smalltbl_1
-			  : currprefs.cpu_level == 1 ? op_smalltbl_2
-			  : currprefs.cpu_compatible ? op_smalltbl_4
-			  : op_smalltbl_3);
+    const struct cputbl *tbl, *fuse;
+    const uae_u16 *idx;
+
+    if (currprefs.cpu_level == 3) {
+	tbl = op_smalltbl_0;
+	idx = op_functbl_idx_0;
+	fuse = op_fusetbl_0;
+    } else if (currprefs.cpu_level == 2) {
+	tbl = op_smalltbl_1;
+	idx = op_functbl_idx_1;
+	fuse = op_fusetbl_1;
+    } else if (currprefs.cpu_level == 1) {
+	tbl = op_smalltbl_2;
+	idx = op_functbl_idx_2;
+	fuse = op_fusetbl_2;
+    } else if (currprefs.cpu_compatible) {
+	tbl = op_smalltbl_4;
+	idx = op_functbl_idx_4;
+	fuse = op_fusetbl_4;
+    } else {
+	tbl = op_smalltbl_3;
+	idx = op_functbl_idx_3;
+	fuse = op_fusetbl_3;
+    }
 
     /* write_log ("Building CPU function table (%d %d %d).\n", currprefs.cpu_level, currprefs.cpu_compatible, currprefs.address_space_24); */
 
-    for (opcode = 0; opcode < 65536; opcode++)
-	cpufunctbl[cft_map (opcode)] = op_illg_1;
-    for (i = 0; tbl[i].handler != NULL; i++) {
-	if (! tbl[i].specific)
-	    cpufunctbl[cft_map (tbl[i].opcode)] = tbl[i].handler;
-    }
+    /* gencpu has already resolved the merged opcodes. Illegal opcodes
+     * point at the terminating row, which has no handler. */
     for (opcode = 0; opcode < 65536; opcode++) {
-	cpuop_func *f;
+	cpuop_func *f = tbl[idx[opcode]].handler;
+	cpufunctbl[cft_map (opcode)] = f ? f : op_illg_1;
+    }
+    /* The predecode cache, the JIT and the profiler need to see every
+     * instruction, so only the plain interpreter gets superinstructions. */
+    if (!currprefs.cpu_predecode && !currprefs.cpu_jit && !m68k_profile) {
+	for (i = 0; fuse[i].handler != NULL; i++)
+	    cpufunctbl[cft_map (fuse[i].opcode)] = fuse[i].handler;
+    }
+    predecode_flush ();
+}
 
-	if (table68k[opcode].mnemo == i_ILLG || table68k[opcode].clev > currprefs.cpu_level)
-	    continue;
+#ifdef UADE_THREADED_CPU
+/* Same as build_cpufunctbl(), but fills the label table of a threaded
+ * runner. */
+void build_cputhrtbl (void **table, const struct cputhr *tbl,
+		      const uae_u16 *idx, void *illg)
+{
+    unsigned long opcode;
 
-	if (table68k[opcode].handler != -1) {
-	    f = cpufunctbl[cft_map (table68k[opcode].handler)];
-	    if (f == op_illg_1)
-		abort();
-	    cpufunctbl[cft_map (opcode)] = f;
-	}
-    }
-    for (i = 0; tbl[i].handler != NULL; i++) {
-	if (tbl[i].specific)
-	    cpufunctbl[cft_map (tbl[i].opcode)] = tbl[i].handler;
+    for (opcode = 0; opcode < 65536; opcode++) {
+	void *l = tbl[idx[opcode]].label;
+	table[cft_map (opcode)] = l ? l : illg;
     }
 }
+#endif
 
 unsigned long cycles_mask, cycles_val;
 
@@ -228,8 +254,8 @@ void init_m68k (void)
     }
 #endif
 
-    read_table68k ();
-    do_merges ();
+    /* Only read through table68k from here on */
+    table68k = (struct instr *) table68k_data;
 
     build_cpufunctbl ();
 }
@@ -1084,6 +1110,8 @@ void m68k_reset (void)
   regs.intmask = 7;
   regs.vbr = regs.sfc = regs.dfc = 0;
   regs.fpcr = regs.fpsr = regs.fpiar = 0;
+
+  predecode_flush ();
 }
 
 unsigned long REGPARAM2 op_illg (uae_u32 opcode)
@@ -1198,11 +1226,64 @@ static void do_trace (void)
 }
 
 
+/* Idle loop detection. Custom registers that only change at events set
+ * SPCFLAG_POLL when read. If the CPU comes back to the same read with the
+ * same registers and flags, and nothing was written, no event happened and
+ * no cycle dependent register (VHPOSR, CIA) was read in between, then every
+ * following loop iteration is identical until the next event. Those
+ * iterations are skipped by adding their cycles at once. Only whole
+ * iterations that end before nextevent are skipped, so events happen at
+ * the same cycle as without skipping. */
+static struct {
+    uaecptr pc;
+    unsigned long cycles, nextevent;
+    uae_u32 writes, unstable;
+    struct regstruct regs;
+    struct flag_struct flags;
+} idle;
+
+#define IDLE_MAX_LOOP_CYCLES 256
+
+static void idle_poll (void)
+{
+    uaecptr pc = m68k_getpc ();
+    unsigned long loop = cycles - idle.cycles;
+    unsigned long n;
+
+    FLUSH_FLAGS;
+    if (pc == idle.pc && regs.spcflags == 0
+	&& loop > 0 && loop <= IDLE_MAX_LOOP_CYCLES
+	&& nextevent == idle.nextevent
+	&& mem_writes == idle.writes && unstable_reads == idle.unstable
+	&& memcmp (&regs, &idle.regs, sizeof regs) == 0
+	&& memcmp (&regflags, &idle.flags, sizeof regflags) == 0) {
+	n = (nextevent - cycles - 1) / loop;
+	cycles += n * loop;
+    }
+
+    idle.pc = pc;
+    idle.cycles = cycles;
+    idle.nextevent = nextevent;
+    idle.writes = mem_writes;
+    idle.unstable = unstable_reads;
+    memcpy (&idle.regs, &regs, sizeof regs);
+    memcpy (&idle.flags, &regflags, sizeof regflags);
+}
+
 static int do_specialties (void)
 {
+    if (regs.spcflags & SPCFLAG_POLL) {
+	regs.spcflags &= ~SPCFLAG_POLL;
+	idle_poll ();
+    }
+
     while (regs.spcflags & SPCFLAG_STOP) {
         if (uadecore_reboot)
 	    return 1;
+	/* Nothing but an event can end STOP. Skip the 4 cycle steps
+	 * that can not reach the next event. */
+	if (nextevent - cycles > 4)
+	    cycles += ((nextevent - cycles - 1) / 4) * 4;
 	do_cycles (4);
 	if (regs.spcflags & (SPCFLAG_INT | SPCFLAG_DOINT)){
 	    int intr = intlev ();
@@ -1234,11 +1315,394 @@ static int do_specialties (void)
     return 0;
 }
 
+/* Predecoded instruction cache (cpu_predecode option in uaerc).
+ *
+ * Blocks of up to PREDECODE_BLOCK_LEN instructions are stored in a direct
+ * mapped table keyed by the host address of the first opcode. A block ends
+ * at a flow control instruction. Only code in chip memory is cached, because
+ * chipmem_*put in memory.c tracks writes to pages that hold predecoded
+ * opcodes. Generated handlers fetch their extension words from regs.pc_p
+ * and return their own cycle counts, so only the opcode and the handler
+ * pointer are cached, and a block is stale only when one of its opcode
+ * words is written. Each instruction is executed only if regs.pc_p still
+ * matches the recorded address, so taken branches and exceptions simply
+ * leave the block.
+ *
+ * With the cpu_jit option blocks that have been entered JIT_THRESHOLD
+ * times are translated to host code by jit.c. */
+#define PREDECODE_BLOCK_LEN 16
+#define PREDECODE_HASH_SIZE 4096
+#define JIT_THRESHOLD 16
+
+struct predecode_block {
+    uae_u8 *pc_p;
+    uae_u32 gen;
+    uae_u32 epoch;
+    int firstpage, lastpage;
+    int n;
+    int hits;
+    jit_func *native;
+    struct predecode_insn insn[PREDECODE_BLOCK_LEN];
+};
+
+static struct predecode_block *predecode_blocks;
+static uae_u32 predecode_epoch;
+
+static unsigned long predecode_hits, predecode_misses, predecode_insns;
+static uae_u32 predecode_oldgen;
+
+/* Must be called when chip memory is written behind chipmem_*put */
+void predecode_flush (void)
+{
+    predecode_epoch++;
+}
+
+/* Statistics are only printed when the debugger has been activated
+   (uade123 --debug), but the counters are reset on every reboot. */
+void predecode_report (void)
+{
+    if (currprefs.cpu_jit)
+	jit_report ();
+    if (uadecore_debug && (currprefs.cpu_predecode || currprefs.cpu_jit))
+	fprintf (stderr, "uadecore: predecode: %lu block hits, %lu misses, "
+		 "%lu cached instructions, %lu invalidations\n",
+		 predecode_hits, predecode_misses, predecode_insns,
+		 (unsigned long) (chipmem_codegen - predecode_oldgen));
+    predecode_hits = predecode_misses = predecode_insns = 0;
+    predecode_oldgen = chipmem_codegen;
+}
+
+static inline int predecode_ends_block (uae_u32 opcode)
+{
+    switch (table68k[opcode].mnemo) {
+    case i_ILLG: case i_TRAP: case i_STOP: case i_RTE: case i_RTD:
+    case i_RTS: case i_TRAPV: case i_RTR: case i_JSR: case i_JMP:
+    case i_BSR: case i_Bcc: case i_DBcc: case i_CHK: case i_CHK2:
+    case i_BKPT: case i_CALLM: case i_RTM: case i_TRAPcc: case i_FDBcc:
+    case i_FTRAPcc: case i_FBcc: case i_MV2SR: case i_ORSR: case i_ANDSR:
+    case i_EORSR: case i_RESET:
+	return 1;
+    default:
+	return 0;
+    }
+}
+
+static struct predecode_block *predecode_lookup (uae_u8 *pc_p)
+{
+    struct predecode_block *b;
+    int page;
+
+    b = &predecode_blocks[((pc_p - chipmemory) >> 1) & (PREDECODE_HASH_SIZE - 1)];
+    if (b->pc_p != pc_p || b->epoch != predecode_epoch || b->n == 0)
+	return NULL;
+    if (b->gen != chipmem_codegen) {
+	/* Some code page was written. Check if it was one of ours. */
+	for (page = b->firstpage; page <= b->lastpage; page++) {
+	    if (chipmem_pagegen[page] > b->gen)
+		return NULL;
+	}
+	b->gen = chipmem_codegen;
+    }
+    return b;
+}
+
+/* Add cycles of one instruction and handle special flags, like the
+ * loop in m68k_run_1() does. Returns non-zero if the loop must stop. */
+static inline int predecode_cycles (int cycles)
+{
+    if (uadecore_time_critical)
+	cycles = 1;
+    cycles &= cycles_mask;
+    cycles |= cycles_val;
+    do_cycles (cycles);
+
+    if (regs.spcflags) {
+	if (do_specialties ())
+	    return 1;
+    }
+    return uadecore_reboot;
+}
+
+int jit_cycles (unsigned long pending, int cycles)
+{
+    do_cycles (pending);
+    return predecode_cycles (cycles);
+}
+
+/* Translated code has the effective cycles of native instructions built
+ * in. It is thrown away when they would change. */
+static int jit_time_critical;
+static unsigned long jit_cycles_mask, jit_cycles_val;
+
+static inline int jit_cycle_mode_changed (void)
+{
+    if (uadecore_time_critical == jit_time_critical
+	&& cycles_mask == jit_cycles_mask && cycles_val == jit_cycles_val)
+	return 0;
+    jit_time_critical = uadecore_time_critical;
+    jit_cycles_mask = cycles_mask;
+    jit_cycles_val = cycles_val;
+    jit_reset ();
+    predecode_flush ();
+    return 1;
+}
+
+/* Instruction profile, enabled for one song at a time with
+ * UADE_COMMAND_CPU_PROFILE. Executed opcodes and pairs of consecutive
+ * opcodes are counted, and the most frequent ones are sent to libuade when
+ * the song ends. Pairs that do not find a slot in the hash table are not
+ * counted. */
+#define PROFILE_PAIR_SLOTS 65536
+#define PROFILE_PAIR_PROBES 16
+#define PROFILE_TOP 128
+
+struct profile_count {
+    uae_u32 key;
+    uae_u32 count;
+};
+
+int m68k_profile;
+static uae_u32 *profile_ops;
+static struct profile_count *profile_pairs;
+static uae_u64 profile_total;
+static uae_u32 profile_prev;
+
+void m68k_profile_start (void)
+{
+    if (profile_ops == NULL) {
+	profile_ops = calloc (65536, sizeof profile_ops[0]);
+	profile_pairs = calloc (PROFILE_PAIR_SLOTS, sizeof profile_pairs[0]);
+	if (profile_ops == NULL || profile_pairs == NULL) {
+	    fprintf (stderr, "uadecore: No memory for the cpu profile.\n");
+	    exit (1);
+	}
+    } else {
+	memset (profile_ops, 0, 65536 * sizeof profile_ops[0]);
+	memset (profile_pairs, 0, PROFILE_PAIR_SLOTS * sizeof profile_pairs[0]);
+    }
+    profile_total = 0;
+    profile_prev = 0x10000;
+    if (!m68k_profile) {
+	m68k_profile = 1;
+	build_cpufunctbl ();
+    }
+}
+
+static inline void profile_count (uae_u32 opcode)
+{
+    uae_u32 pair, h;
+    int i;
+
+    opcode = cft_map (opcode);
+    profile_total++;
+    profile_ops[opcode]++;
+    if (profile_prev < 0x10000) {
+	pair = (profile_prev << 16) | opcode;
+	h = (pair * 2654435761U) >> 16;
+	for (i = 0; i < PROFILE_PAIR_PROBES; i++) {
+	    struct profile_count *p = &profile_pairs[(h + i) & (PROFILE_PAIR_SLOTS - 1)];
+	    if (p->count == 0)
+		p->key = pair;
+	    if (p->key == pair) {
+		p->count++;
+		break;
+	    }
+	}
+    }
+    profile_prev = opcode;
+}
+
+static void m68k_run_profile (void)
+{
+    uae_u32 opcode;
+
+    while (1) {
+	opcode = GET_OPCODE;
+	profile_count (opcode);
+	if (predecode_cycles ((*cpufunctbl[opcode]) (opcode)))
+	    return;
+    }
+}
+
+/* Keeps the n largest counts in descending order */
+static int profile_top (struct profile_count *top, int n, uae_u32 key, uae_u32 count)
+{
+    int i;
+
+    if (count == 0 || (n == PROFILE_TOP && count <= top[n - 1].count))
+	return n;
+    if (n < PROFILE_TOP)
+	n++;
+    for (i = n - 1; i > 0 && top[i - 1].count < count; i--)
+	top[i] = top[i - 1];
+    top[i].key = key;
+    top[i].count = count;
+    return n;
+}
+
+void m68k_profile_send (void)
+{
+    uint8_t space[UADE_MAX_MESSAGE_SIZE];
+    struct uade_msg *um = (struct uade_msg *) space;
+    uint32_t *u32ptr = (uint32_t *) um->data;
+    struct profile_count top[PROFILE_TOP];
+    int i, n, nops;
+
+    u32ptr[0] = htonl ((uint32_t) (profile_total >> 32));
+    u32ptr[1] = htonl ((uint32_t) profile_total);
+    u32ptr += 4;
+
+    for (i = n = 0; i < 65536; i++)
+	n = profile_top (top, n, i, profile_ops[i]);
+    for (i = 0; i < n; i++) {
+	*u32ptr++ = htonl (top[i].key);
+	*u32ptr++ = htonl (top[i].count);
+    }
+    nops = n;
+
+    for (i = n = 0; i < PROFILE_PAIR_SLOTS; i++)
+	n = profile_top (top, n, profile_pairs[i].key, profile_pairs[i].count);
+    for (i = 0; i < n; i++) {
+	*u32ptr++ = htonl (top[i].key);
+	*u32ptr++ = htonl (top[i].count);
+    }
+
+    u32ptr = (uint32_t *) um->data;
+    u32ptr[2] = htonl (nops);
+    u32ptr[3] = htonl (n);
+    um->msgtype = UADE_REPLY_CPU_PROFILE;
+    um->size = 16 + 8 * (nops + n);
+    if (uade_send_message (um, &uadecore_ipc)) {
+	fprintf (stderr, "uadecore: Could not send cpu profile.\n");
+	exit (1);
+    }
+
+    m68k_profile = 0;
+    build_cpufunctbl ();
+}
+
+static void m68k_run_predecode (void)
+{
+    struct predecode_block *b;
+    struct predecode_insn *in;
+    uae_u8 *pc_p;
+    uae_u32 opcode;
+    uae_u32 gen;
+    int page;
+    int i;
+
+    if (predecode_blocks == NULL) {
+	predecode_blocks = calloc (PREDECODE_HASH_SIZE, sizeof predecode_blocks[0]);
+	if (predecode_blocks == NULL) {
+	    fprintf (stderr, "uadecore: No memory for predecode cache.\n");
+	    exit (1);
+	}
+    }
+    if (currprefs.cpu_jit && !jit_init ()) {
+	fprintf (stderr, "uadecore: JIT is not available. Using the predecode cache.\n");
+	currprefs.cpu_jit = 0;
+    }
+
+    while (1) {
+	pc_p = regs.pc_p;
+
+	if (pc_p < chipmemory || pc_p >= (chipmemory + allocated_chipmem)) {
+	    opcode = GET_OPCODE;
+	    if (predecode_cycles ((*cpufunctbl[opcode]) (opcode)))
+		return;
+	    continue;
+	}
+
+	b = predecode_lookup (pc_p);
+	if (b != NULL) {
+	    predecode_hits++;
+	    if (currprefs.cpu_jit && jit_cycle_mode_changed ())
+		continue;
+	    if (b->native != NULL) {
+		if ((*b->native) ())
+		    return;
+		continue;
+	    }
+	    if (currprefs.cpu_jit && ++b->hits == JIT_THRESHOLD) {
+		b->native = jit_translate (b->insn, b->n);
+		if (b->native == NULL) {
+		    /* Code buffer is full. Start over. */
+		    jit_reset ();
+		    predecode_flush ();
+		}
+		continue;
+	    }
+	    gen = chipmem_codegen;
+	    for (i = 0; i < b->n; i++) {
+		in = &b->insn[i];
+		if (regs.pc_p != in->pc_p)
+		    break;
+		predecode_insns++;
+		if (predecode_cycles ((*in->handler) (in->opcode)))
+		    return;
+		/* The block may have modified itself */
+		if (chipmem_codegen != gen)
+		    break;
+	    }
+	    continue;
+	}
+
+	/* Miss: execute and record a new block */
+	predecode_misses++;
+	b = &predecode_blocks[((pc_p - chipmemory) >> 1) & (PREDECODE_HASH_SIZE - 1)];
+	b->pc_p = pc_p;
+	b->epoch = predecode_epoch;
+	b->gen = chipmem_codegen;
+	b->firstpage = b->lastpage = (pc_p - chipmemory) >> CHIPMEM_PAGE_SHIFT;
+	b->n = 0;
+	b->hits = 0;
+	b->native = NULL;
+
+	while (b->n < PREDECODE_BLOCK_LEN) {
+	    pc_p = regs.pc_p;
+	    if (pc_p < chipmemory || pc_p >= (chipmemory + allocated_chipmem))
+		break;
+	    page = (pc_p - chipmemory) >> CHIPMEM_PAGE_SHIFT;
+	    /* Keep blocks sequential so that the page range stays small */
+	    if (b->n > 0 && (pc_p <= b->insn[b->n - 1].pc_p || page > b->lastpage + 1))
+		break;
+
+	    opcode = GET_OPCODE;
+	    in = &b->insn[b->n++];
+	    in->pc_p = pc_p;
+	    in->opcode = opcode;
+	    in->handler = cpufunctbl[opcode];
+	    chipmem_codepages[page] = 1;
+	    b->lastpage = page;
+
+	    in->cycles = (*in->handler) (opcode);
+	    if (predecode_cycles (in->cycles))
+		return;
+	    if (chipmem_codegen != b->gen) {
+		/* Self-modifying code, do not trust the block */
+		b->n = 0;
+		break;
+	    }
+	    if (predecode_ends_block (opcode))
+		break;
+	}
+    }
+}
+
 void m68k_run_1 (void)
 {
   int cycles;
   uae_u32 opcode;
 
+  if (m68k_profile) {
+    m68k_run_profile ();
+    return;
+  }
+  if (currprefs.cpu_predecode || currprefs.cpu_jit) {
+    m68k_run_predecode ();
+    return;
+  }
+
 #if EXCEPTION_COUNT
   int uade_revs = 0;
   int uade_otime = 0;
@@ -1297,6 +1761,32 @@ void m68k_run_1 (void)
   }
 }
 
+#ifdef UADE_THREADED_CPU
+/* The threaded runners return only when regs.spcflags is set or the core
+ * is being rebooted. */
+static void m68k_run_threaded (void)
+{
+  void (*run) (void);
+
+  while (1) {
+    run = (currprefs.cpu_level == 3 ? m68k_run_threaded_0
+	   : currprefs.cpu_level == 2 ? m68k_run_threaded_1
+	   : currprefs.cpu_level == 1 ? m68k_run_threaded_2
+	   : currprefs.cpu_compatible ? m68k_run_threaded_4
+	   : m68k_run_threaded_3);
+    run ();
+
+    if (regs.spcflags) {
+      if (do_specialties ())
+	break;
+    }
+
+    if (uadecore_reboot)
+      break;
+  }
+}
+#endif
+
 int in_m68k_go = 0;
 
 void m68k_go (void)
@@ -1316,10 +1806,20 @@ void m68k_go (void)
 	debug ();
       if (quit_program != 0)
 	break;
+#ifdef UADE_THREADED_CPU
+      if (currprefs.cpu_predecode || currprefs.cpu_jit || m68k_profile)
+	m68k_run_1 ();
+      else
+	m68k_run_threaded ();
+#else
       m68k_run_1 ();
+#endif
     }
 
     if (uadecore_reboot) {
+      predecode_report ();
+      if (m68k_profile)
+	m68k_profile_send ();
       if (uade_send_short_message(UADE_COMMAND_TOKEN, &uadecore_ipc) < 0) {
 	fprintf(stderr, "can not send reboot ack token\n");
 	exit(1);
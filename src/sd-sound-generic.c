@@ -18,11 +18,18 @@
 #include "uadectl.h"
 #include <uade/uadeconstants.h>
 
-uae_u16 sndbuffer[MAX_SOUND_BUF_SIZE / 2];
-uae_u16 *sndbufpt;
+static uae_u32 sndbuffer_storage[MAX_SOUND_BUF_SIZE / 4];
+/* Points to a slot of the shared sample ring when uadecore has one */
+uae_u32 *sndbuffer = sndbuffer_storage;
+uae_u8 *sndbufpt;
 int sndbufsize;
 
 int sound_bytes_per_second;
+int sound_bytes_per_sample = 2;
+int sound_bytes_per_frame = 4;
+int sound_sample_format = UADE_SAMPLE_S16;
+/* Output the four Paula voices instead of the stereo mix */
+int sound_separate_voices;
 
 void close_sound (void)
 {
@@ -39,11 +46,29 @@ int setup_sound (void)
 void set_sound_freq(int x)
 {
   /* Validation is done later in init_sound() */
+  audio_flush_filter();
   currprefs.sound_freq = x;
   init_sound();
 }
 
 
+void set_sound_format(int format)
+{
+  /* Validation is done later in init_sound() */
+  audio_flush_filter();
+  sound_sample_format = format;
+  init_sound();
+}
+
+
+void set_sound_separate_voices(int separate)
+{
+  audio_flush_filter();
+  sound_separate_voices = separate;
+  init_sound();
+}
+
+
 void init_sound (void)
 {
   int channels;
@@ -72,18 +97,29 @@ void init_sound (void)
     fprintf(stderr, "Only stereo supported.\n");
     exit(1);
   }
+  if (sound_sample_format < 0 || sound_sample_format >= UADE_SAMPLE_FORMAT_UPPER_BOUND) {
+    fprintf(stderr, "Unknown sample format: %d\n", sound_sample_format);
+    exit(1);
+  }
 
-  sound_bytes_per_second = (dspbits / 8) *  channels * rate;
+  /* dspbits is the precision of Paula emulation, not of the output. The
+     output format is negotiated with the frontend. */
+  sound_bytes_per_sample = (sound_sample_format == UADE_SAMPLE_S16) ? 2 : 4;
+  if (sound_separate_voices)
+    channels = 4;
+  sound_bytes_per_frame = sound_bytes_per_sample * channels;
+  sound_bytes_per_second = sound_bytes_per_frame * rate;
 
   audio_set_rate(rate);
 
   sound_available = 1;
   
-  sndbufpt = sndbuffer;
+  sndbufpt = (uae_u8 *) sndbuffer;
 }
 
 /* this should be called between subsongs when remote slave changes subsong */
 void flush_sound (void)
 {
-  sndbufpt = sndbuffer;
+  audio_flush_filter();
+  sndbufpt = (uae_u8 *) sndbuffer;
 }
@@ -13,10 +13,14 @@
 
 #define MAX_SOUND_BUF_SIZE (65536)
 
-extern uae_u16 sndbuffer[];
-extern uae_u16 *sndbufpt;
+extern uae_u32 *sndbuffer;
+extern uae_u8 *sndbufpt;
 extern int sndbufsize;
 extern int sound_bytes_per_second;
+extern int sound_bytes_per_sample;
+extern int sound_bytes_per_frame;
+extern int sound_sample_format;
+extern int sound_separate_voices;
 
 extern void finish_sound_buffer (void);
 
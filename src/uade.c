@@ -9,6 +9,9 @@
 #include <ctype.h>
 #include <dirent.h>
 #include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/resource.h>
 #include <time.h>
 #include <limits.h>
 
@@ -86,6 +89,8 @@ int uadecore_audio_skip;
 int uadecore_audio_output;
 int uadecore_debug;
 int uadecore_read_size;
+/* Bytes to render before the next data message */
+int uadecore_block_size;
 int uadecore_reboot;
 int uadecore_time_critical;
 
@@ -208,12 +213,14 @@ static int calc_reloc_size(uae_u32 *src, uae_u32 *end)
 /* last part of the audio system pipeline */
 void uadecore_check_sound_buffers(int bytes)
 {
-  uint8_t space[UADE_MAX_MESSAGE_SIZE];
-  struct uade_msg *um = (struct uade_msg *) space;
-
-  /* transmit in big endian format, so swap if little endian */
-  if (big_endian == 0)
-    uadecore_swap_buffer_bytes(sndbuffer, bytes);
+  /* transmit in big endian format, so swap if little endian, unless
+     the frontend asked for samples in host byte order */
+  if (big_endian == 0 && !uadecore_ipc.native_samples) {
+    if (sound_bytes_per_sample == 2)
+      uadecore_swap_buffer_bytes(sndbuffer, bytes);
+    else
+      uadecore_swap_buffer_longs(sndbuffer, bytes);
+  }
 
   /* LED state changes are reported here because we are in send state and
      this place is heavily rate limited. */
@@ -222,16 +229,26 @@ void uadecore_check_sound_buffers(int bytes)
     uadecore_send_debug("LED is %s", gui_ledstate ? "ON" : "OFF");
   }
 
-  um->msgtype = UADE_REPLY_DATA;
-  um->size = bytes;
-  memcpy(um->data, sndbuffer, bytes);
-  if (uade_send_message(um, &uadecore_ipc)) {
-    fprintf(stderr, "uadecore: Could not send sample data.\n");
-    exit(1);
+  if (uadecore_ipc.ring != NULL) {
+    /* The samples were rendered into the ring slot. Tell the frontend
+       where they are, and render the next block into the next slot. */
+    uint32_t offset = ((uae_u8 *) sndbuffer) - uadecore_ipc.ring;
+    if (uade_send_two_u32s(UADE_REPLY_RING_DATA, offset, bytes, &uadecore_ipc)) {
+      fprintf(stderr, "uadecore: Could not send sample data.\n");
+      exit(1);
+    }
+    offset = (offset + UADE_RING_SLOT_SIZE) % UADE_RING_SIZE;
+    sndbuffer = (uae_u32 *) (uadecore_ipc.ring + offset);
+  } else {
+    if (uade_send_message_data(UADE_REPLY_DATA, sndbuffer, bytes, &uadecore_ipc)) {
+      fprintf(stderr, "uadecore: Could not send sample data.\n");
+      exit(1);
+    }
   }
 
   uadecore_read_size -= bytes;
   assert(uadecore_read_size >= 0);
+  uadecore_block_size = uadecore_read_size < UADE_READ_BLOCK_SIZE ? uadecore_read_size : UADE_READ_BLOCK_SIZE;
 
   if (uadecore_read_size == 0) {
     /* if all requested data has been sent, move to S state */
@@ -268,6 +285,7 @@ static int uade_safe_copy(int dst, const void *buf, size_t buflen)
 		return 0;
 	}
 	memcpy(get_real_address(dst), buf, buflen);
+	predecode_flush();
 	return (int) buflen;
 }
 
@@ -510,6 +528,7 @@ void uadecore_get_amiga_message(void)
     dststr = (char *) get_real_address(dst);
     uadecore_send_debug("score issued an info request: %s (maxlen %d)", srcstr, len);
     len = get_info_for_ep(dststr, srcstr, len);
+    predecode_flush();
     /* Send printable debug */
     do {
       size_t i;
@@ -607,6 +626,27 @@ void uadecore_handle_r_state(void)
       set_sound_freq(x);
       break;
 
+    case UADE_COMMAND_SEPARATE_VOICES:
+      set_sound_separate_voices(1);
+      break;
+
+    case UADE_COMMAND_SET_SAMPLE_FORMAT:
+      if (uade_parse_u32_message(&x, um)) {
+	fprintf(stderr, "Invalid sample format message size: %u\n", um->size);
+	exit(1);
+      }
+      set_sound_format(x);
+      break;
+
+    case UADE_COMMAND_SAMPLE_BYTE_ORDER:
+      /* Without this command samples are sent in big endian */
+      if (uade_parse_u32_message(&x, um)) {
+	fprintf(stderr, "Invalid sample byte order message size: %u\n", um->size);
+	exit(1);
+      }
+      uadecore_ipc.native_samples = (x != 0 || uadecore_ipc.ring != NULL);
+      break;
+
     case UADE_COMMAND_SET_PLAYER_OPTION:
       uade_check_fix_string(um, 256);
       add_ep_option((char *) um->data);
@@ -621,6 +661,10 @@ void uadecore_handle_r_state(void)
       uadecore_time_critical = 1;
       break;
 
+    case UADE_COMMAND_PERIOD_CLAMP:
+      audio_set_period_clamp(1);
+      break;
+
     case UADE_COMMAND_READ:
       if (uadecore_read_size != 0) {
 	fprintf(stderr, "uadecore: Read not allowed when uadecore_read_size > 0.\n");
@@ -631,10 +675,11 @@ void uadecore_handle_r_state(void)
 	exit(1);
       }
       uadecore_read_size = x;
-      if (uadecore_read_size == 0 || uadecore_read_size > MAX_SOUND_BUF_SIZE || (uadecore_read_size & 3) != 0) {
+      if (uadecore_read_size == 0 || uadecore_read_size > UADE_MAX_READ_SIZE || (uadecore_read_size % sound_bytes_per_frame) != 0) {
 	fprintf(stderr, "uadecore: Invalid read size: %d\n", uadecore_read_size);
 	exit(1);
       }
+      uadecore_block_size = uadecore_read_size < UADE_READ_BLOCK_SIZE ? uadecore_read_size : UADE_READ_BLOCK_SIZE;
       break;
 
     case UADE_COMMAND_REBOOT:
@@ -663,6 +708,10 @@ void uadecore_handle_r_state(void)
       audio_use_text_scope();
       break;
 
+    case UADE_COMMAND_CPU_PROFILE:
+      m68k_profile_start();
+      break;
+
     default:
       fprintf(stderr, "uadecore: Received invalid command %d\n", um->msgtype);
       exit(1);
@@ -681,6 +730,7 @@ void uadecore_option(int argc, char **argv)
   int ret;
   int in_fd = -1;
   int out_fd = -1;
+  int ring_fd = -1;
   char *endptr;
 
   /* network byte order is the big endian order */
@@ -739,6 +789,20 @@ void uadecore_option(int argc, char **argv)
 	}
 	i += 2;
 
+      } else if (!strcmp(argv[i], "-r")) {
+	if ((i + 1) >= argc) {
+	  fprintf(stderr, "uadecore: %s parameter missing\n", argv[i]);
+	  uade_print_help(OPTION_ILLEGAL_PARAMETERS, argv[0]);
+	  exit(1);
+	}
+	ring_fd = strtol(argv[i + 1], &endptr, 10);
+	if (ring_fd < 0 || *endptr != 0) {
+		fprintf(stderr, "uadecore: Invalid -r parameter: %s\n",
+			argv[i + 1]);
+		exit(1);
+	}
+	i += 2;
+
       } else if (!strcmp(argv[i], "--")) {
 	for (i = i + 1; i < argc ; i++)
 	  s_argv[s_argc++] = argv[i];
@@ -760,6 +824,20 @@ void uadecore_option(int argc, char **argv)
 
   uade_set_peer(&uadecore_ipc, 0, in_fd, out_fd);
 
+  if (ring_fd >= 0) {
+    void *ring = mmap(NULL, UADE_RING_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd, 0);
+    if (ring == MAP_FAILED) {
+      fprintf(stderr, "uadecore: Can not map the sample ring: %s\n", strerror(errno));
+      exit(1);
+    }
+    close(ring_fd);
+    uadecore_ipc.ring = ring;
+    /* Samples in the shared ring are always in host byte order */
+    uadecore_ipc.native_samples = 1;
+    sndbuffer = ring;
+    sndbufpt = ring;
+  }
+
   ret = uade_receive_string(optionsfile, UADE_COMMAND_CONFIG, sizeof(optionsfile), &uadecore_ipc);
   if (ret == 0) {
     fprintf(stderr, "uadecore: No config file passed as a message.\n");
@@ -807,11 +885,29 @@ static void uade_print_help(enum print_help problemcode, char *progname)
   fprintf(stderr, " -h\t\tPrint help\n");
   fprintf(stderr, " -i file\tSet input source ('filename' or 'fd://number')\n");
   fprintf(stderr, " -o file\tSet output destination ('filename' or 'fd://number'\n");
+  fprintf(stderr, " -r fd\t\tRender samples into a shared memory ring (memfd)\n");
   fprintf(stderr, "\n");
   fprintf(stderr, "This tool should not be run from the command line. This is for internal use\n");
   fprintf(stderr, "of other programs.\n");
 }
 
+/* Set UADECORE_STARTUP_TIME in the environment to see how much the process
+   spent (including exec and dynamic linking) before it was ready to take
+   the first UADE_COMMAND_SCORE. */
+static void uadecore_report_startup(void)
+{
+  struct timespec ts;
+  struct rusage ru;
+
+  if (getenv("UADECORE_STARTUP_TIME") == NULL)
+    return;
+  if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) || getrusage(RUSAGE_SELF, &ru))
+    return;
+  fprintf(stderr, "uadecore: startup: %ld us cpu time, %ld page faults\n",
+	  (long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000,
+	  ru.ru_minflt + ru.ru_majflt);
+}
+
 /* this is called for each played song from newcpu.c/m68k_reset() */
 void uadecore_reset(void)
 {
@@ -833,6 +929,7 @@ void uadecore_reset(void)
   struct uade_msg *um = (struct uade_msg *) command;
 
   int ret;
+  static int started;
 
   invalidate_amiga_file_cache();
 
@@ -856,10 +953,18 @@ void uadecore_reset(void)
   if (highmem < 0x200000) {
     fprintf(stderr, "uadecore: Warning: highmem == 0x%x (< 0x200000)!\n", highmem);
   }
-  memset(get_real_address(0), 0, highmem);
+  /* Before the first song the memory is still zero from memory_init().
+     Skipping the memset then avoids faulting in all of it at startup. */
+  if (started)
+    memset(get_real_address(0), 0, highmem);
 
   song.cur_subsong = song.min_subsong = song.max_subsong = 0;
 
+  if (!started) {
+    uadecore_report_startup();
+    started = 1;
+  }
+
   ret = uade_receive_string(song.scorename, UADE_COMMAND_SCORE, sizeof(song.scorename), &uadecore_ipc);
   if (ret == 0) {
     exit(0);
@@ -1025,6 +1130,9 @@ void uadecore_reset(void)
     exit(1);
   }
 
+  set_sound_separate_voices(0);
+  set_sound_format(UADE_SAMPLE_S16);
+  audio_set_period_clamp(0);
   set_sound_freq(UADE_DEFAULT_FREQUENCY);
   epoptionsize = 0;
 
@@ -1064,6 +1172,7 @@ static void uade_put_long(int addr, int val)
   }
   p = (uae_u32 *) get_real_address(addr);
   *p = htonl(val);
+  predecode_flush();
 }
 
 static int uade_safe_load(int dst, FILE *file, int maxlen)
@@ -1164,6 +1273,10 @@ void uadecore_song_end(char *reason, int kill_it)
      uade must finish the pending sound data request (for the client) even if
      the sound core crashed */
   uadecore_audio_output = 1;
+
+  /* The block that has the tail is the last one the frontend wants from
+     this read request. Send the token after it. */
+  uadecore_read_size = uadecore_block_size;
 }
 
 
@@ -1181,6 +1294,23 @@ void uadecore_swap_buffer_bytes(void *data, int bytes)
 }
 
 
+void uadecore_swap_buffer_longs(void *data, int bytes)
+{
+  uae_u8 *buf = (uae_u8 *) data;
+  uae_u8 sample;
+  int i;
+  assert((bytes % 4) == 0);
+  for (i = 0; i < bytes; i += 4) {
+    sample = buf[i + 0];
+    buf[i + 0] = buf[i + 3];
+    buf[i + 3] = sample;
+    sample = buf[i + 1];
+    buf[i + 1] = buf[i + 2];
+    buf[i + 2] = sample;
+  }
+}
+
+
 /* check if string is on a safe zone */
 static int uade_valid_string(uae_u32 address)
 {
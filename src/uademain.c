@@ -147,6 +147,8 @@ void default_prefs (struct uae_prefs *p)
     p->m68k_speed = 4;
     p->cpu_level = 2;
     p->cpu_compatible = 0;
+    p->cpu_predecode = 0;
+    p->cpu_jit = 0;
     p->address_space_24 = 0;
 
     p->fastmem_size = 0x00000000;
@@ -0,0 +1,121 @@
+#include <uade/unixatomic.h>
+#include <uade/sysincludes.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <assert.h>
+#include <unistd.h>
+
+int uade_atomic_close(int fd)
+{
+  while (1) {
+    if (close(fd) < 0) {
+      if (errno == EINTR)
+	continue;
+      return -1;
+    }
+    break;
+  }
+  return 0;
+}
+
+
+int uade_atomic_dup2(int oldfd, int newfd)
+{
+  while (1) {
+    if (dup2(oldfd, newfd) < 0) {
+      if (errno == EINTR)
+	continue;
+      return -1;
+    }
+    break;
+  }
+  return newfd;
+}
+
+ssize_t uade_atomic_read(int fd, const void *buf, size_t count)
+{
+  char *b = (char *) buf;
+  ssize_t bytes_read = 0;
+  ssize_t ret;
+  while (bytes_read < count) {
+    ret = read(fd, &b[bytes_read], count - bytes_read);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN) {
+	fd_set s;
+	FD_ZERO(&s);
+	FD_SET(fd, &s);
+	if (select(fd + 1, &s, NULL, NULL, NULL) == 0)
+	  fprintf(stderr, "atomic_read: very strange. infinite select() returned 0. report this!\n");
+	continue;
+      }
+      return -1;
+    } else if (ret == 0) {
+      return 0;
+    }
+    bytes_read += ret;
+  }
+  return bytes_read;
+}
+
+ssize_t uade_atomic_write(int fd, const void *buf, size_t count)
+{
+  char *b = (char *) buf;
+  ssize_t bytes_written = 0;
+  ssize_t ret;
+  while (bytes_written < count) {
+    ret = write(fd, &b[bytes_written], count - bytes_written);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN) {
+	fd_set s;
+	FD_ZERO(&s);
+	FD_SET(fd, &s);
+	if (select(fd + 1, NULL, &s, NULL, NULL) == 0)
+	  fprintf(stderr, "atomic_write: very strange. infinite select() returned 0. report this!\n");
+	continue;
+      }
+      return -1;
+    }
+    bytes_written += ret;
+  }
+  return bytes_written;
+}
+
+
+/* Writes all of the iovecs. iov is modified if the write is partial. */
+ssize_t uade_atomic_writev(int fd, struct iovec *iov, int iovcnt)
+{
+  ssize_t bytes_written = 0;
+  ssize_t ret;
+  while (iovcnt > 0) {
+    ret = writev(fd, iov, iovcnt);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN) {
+	fd_set s;
+	FD_ZERO(&s);
+	FD_SET(fd, &s);
+	if (select(fd + 1, NULL, &s, NULL, NULL) == 0)
+	  fprintf(stderr, "atomic_writev: very strange. infinite select() returned 0. report this!\n");
+	continue;
+      }
+      return -1;
+    }
+    bytes_written += ret;
+    while (iovcnt > 0 && ret >= (ssize_t) iov->iov_len) {
+      ret -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = ((char *) iov->iov_base) + ret;
+      iov->iov_len -= ret;
+    }
+  }
+  return bytes_written;
+}